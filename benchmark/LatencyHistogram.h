@@ -0,0 +1,76 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Latency histogram in the style of HdrHistogram: each power of two is
+// split into 2^SUB_BUCKET_BITS linear buckets, so a recorded value is kept
+// to within 1% while the whole 64-bit range fits in a few thousand
+// counters. Recording is one increment; each thread keeps its own
+// histograms and they are merged once the run is over.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 7;
+
+    LatencyHistogram() : counts(BUCKETS, 0) {}
+
+    void record(uint64_t value) {
+        counts[bucketOf(value)]++;
+        total++;
+        sum += value;
+        if (value > maxValue) maxValue = value;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; i++) counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxValue; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0; }
+
+    // Smallest recorded value that `percentile` percent of the values do not
+    // exceed (rounded up to its bucket)
+    uint64_t percentile(double percentile) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(percentile / 100 * total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) return bucketMax(i) < maxValue ? bucketMax(i) : maxValue;
+        }
+        return maxValue;
+    }
+
+private:
+    static const uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+    static const size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // Values below SUB_BUCKETS get a bucket each; above that, the bucket is
+    // the power of two and the next SUB_BUCKET_BITS bits below the top one
+    static size_t bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) return value;
+        int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return ((shift + 1) << SUB_BUCKET_BITS) + ((value >> shift) - SUB_BUCKETS);
+    }
+    // Largest value that falls in bucket `i`
+    static uint64_t bucketMax(size_t i) {
+        if (i < SUB_BUCKETS) return i;
+        int shift = static_cast<int>(i >> SUB_BUCKET_BITS) - 1;
+        uint64_t top = (i & (SUB_BUCKETS - 1)) + SUB_BUCKETS + 1;
+        return shift + SUB_BUCKET_BITS + 1 >= 64 ? UINT64_MAX : (top << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maxValue = 0;
+};
+
+#endif
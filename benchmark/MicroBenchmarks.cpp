@@ -0,0 +1,392 @@
+// In-process microbenchmarks (make bench): RedisDatabase operations and the
+// RESP parser called directly, without the network in the way.
+//
+// Each benchmark is run with a growing number of operations until one run
+// lasts --min-time, then --repetitions more times at that count. The report
+// gives the median ns/op over those runs (and their spread, to tell a real
+// change from noise) and allocations/op counted through the server's
+// operator new. With several threads, each works on its own keys and
+// ns/op is per thread: wall time * threads / operations.
+//
+// Usage: my_redis_microbench [--filter TEXT] [--threads 1,2,4]
+//                            [--min-time MS] [--repetitions N] [--format text|csv]
+// --filter keeps the benchmarks whose name contains TEXT; --threads lists
+// the thread counts to run at (default 1 and the number of cores).
+
+#include "../include/RedisDatabase.h"
+#include "../include/RespParser.h"
+#include "../include/Memory.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+// Distinct keys each thread cycles through (a power of two)
+static const size_t KEYS_PER_THREAD = 1 << 16;
+
+struct MicroBenchmark {
+    std::string name;
+    std::string arg;            // Data size the benchmark runs at
+    bool threaded = true;       // Runs at every thread count, else only at 1
+    // Untimed preparation for a run of `ops` operations on each of `threads` threads
+    std::function<void(int threads, uint64_t ops)> setup;
+    // The timed operations [begin, end) of thread `thread`
+    std::function<void(int thread, uint64_t begin, uint64_t end)> run;
+    // Untimed, before every single operation (whole-database benchmarks)
+    std::function<void()> beforeEach;
+};
+
+struct RunResult {
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the database's progress messages out of the report
+class QuietStdout {
+public:
+    QuietStdout() : saved(std::cout.rdbuf(nullptr)) {}
+    ~QuietStdout() {
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+    }
+
+private:
+    std::streambuf* saved;
+};
+
+static RunResult runOnce(const MicroBenchmark& bench, int threads, uint64_t ops) {
+    if (bench.setup) bench.setup(threads, ops);
+
+    if (bench.beforeEach) {
+        uint64_t elapsed = 0, allocs = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            bench.beforeEach();
+            uint64_t a = threadAllocationCount();
+            uint64_t t = nowNs();
+            bench.run(0, i, i + 1);
+            elapsed += nowNs() - t;
+            allocs += threadAllocationCount() - a;
+        }
+        return {static_cast<double>(elapsed) / ops, static_cast<double>(allocs) / ops};
+    }
+
+    // Threads are started first and released together, so thread creation
+    // is not timed
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<uint64_t> allocs(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            ready++;
+            while (!go.load(std::memory_order_acquire)) {}
+            uint64_t a = threadAllocationCount();
+            bench.run(t, 0, ops);
+            allocs[t] = threadAllocationCount() - a;
+        });
+    }
+    while (ready.load() < threads) std::this_thread::yield();
+    uint64_t start = nowNs();
+    go.store(true, std::memory_order_release);
+    for (auto& w : workers) w.join();
+    uint64_t elapsed = nowNs() - start;
+
+    uint64_t totalAllocs = 0;
+    for (auto a : allocs) totalAllocs += a;
+    return {static_cast<double>(elapsed) / ops, static_cast<double>(totalAllocs) / (ops * threads)};
+}
+
+class MicroBenchmarkSuite {
+public:
+    std::string filter;
+    std::vector<int> threadCounts;
+    uint64_t minTimeNs = 200 * 1000000ull;
+    int repetitions = 5;
+    bool csv = false;
+
+    void add(MicroBenchmark bench) { benchmarks.push_back(std::move(bench)); }
+    void runAll();
+
+private:
+    void report(const MicroBenchmark& bench, int threads, uint64_t ops, std::vector<RunResult>& runs);
+    std::vector<MicroBenchmark> benchmarks;
+};
+
+void MicroBenchmarkSuite::runAll() {
+    if (csv) std::cout << "benchmark,size,threads,ops,ns_per_op,spread_pct,allocs_per_op\n";
+    else
+        std::cout << std::left << std::setw(10) << "benchmark" << std::setw(13) << "size" << std::right
+                  << std::setw(8) << "threads" << std::setw(12) << "ops" << std::setw(14) << "ns/op"
+                  << std::setw(10) << "spread" << std::setw(12) << "allocs/op" << "\n";
+
+    for (const auto& bench : benchmarks) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+        for (int threads : threadCounts) {
+            if (!bench.threaded && threads != 1) continue;
+            // Grow the operation count until a run is long enough to time
+            uint64_t ops = 1;
+            while (true) {
+                RunResult r = runOnce(bench, threads, ops);
+                double runNs = r.nsPerOp * ops;
+                if (runNs >= minTimeNs || ops >= (1ull << 30)) break;
+                double scale = runNs > 0 ? minTimeNs / runNs * 1.2 : 100;
+                ops = static_cast<uint64_t>(ops * std::min(100.0, std::max(2.0, scale)));
+            }
+            std::vector<RunResult> runs;
+            for (int i = 0; i < repetitions; i++) runs.push_back(runOnce(bench, threads, ops));
+            report(bench, threads, ops, runs);
+        }
+    }
+}
+
+void MicroBenchmarkSuite::report(const MicroBenchmark& bench, int threads, uint64_t ops, std::vector<RunResult>& runs) {
+    std::sort(runs.begin(), runs.end(), [](const RunResult& a, const RunResult& b) { return a.nsPerOp < b.nsPerOp; });
+    double median = runs[runs.size() / 2].nsPerOp;
+    double spread = median > 0 ? (runs.back().nsPerOp - runs.front().nsPerOp) / median * 100 : 0;
+    double allocs = runs[runs.size() / 2].allocsPerOp;
+
+    std::cout << std::fixed << std::setprecision(1);
+    if (csv) {
+        std::cout << bench.name << "," << bench.arg << "," << threads << "," << ops << "," << median << ","
+                  << spread << "," << std::setprecision(2) << allocs << "\n";
+        return;
+    }
+    std::cout << std::left << std::setw(10) << bench.name << std::setw(13) << bench.arg << std::right
+              << std::setw(8) << threads << std::setw(12) << ops << std::setw(14) << median
+              << std::setw(9) << spread << "%" << std::setw(12) << std::setprecision(2) << allocs << "\n";
+}
+
+// Keys of each thread, built before the timed part so key formatting is
+// not measured. Every benchmark starts from an empty database, so they all
+// use the same keys whatever the type.
+static std::vector<std::vector<std::string>> threadKeys;
+
+static void prepareKeys(int threads) {
+    while (threadKeys.size() < static_cast<size_t>(threads)) {
+        std::vector<std::string> keys;
+        keys.reserve(KEYS_PER_THREAD);
+        size_t t = threadKeys.size();
+        for (size_t i = 0; i < KEYS_PER_THREAD; i++) {
+            keys.push_back("key:" + std::to_string(t) + ":" + std::to_string(i));
+        }
+        threadKeys.push_back(std::move(keys));
+    }
+}
+
+static const std::vector<std::string>& keysOf(int thread) {
+    return threadKeys[thread];
+}
+
+// Where the dump and load benchmarks write their snapshot
+static const std::string snapshotFile = "microbench-" + std::to_string(getpid()) + ".my_rdb";
+
+static std::string sizeLabel(size_t n, const char* unit) {
+    if (n >= 1000000 && n % 1000000 == 0) return std::to_string(n / 1000000) + "M" + unit;
+    if (n >= 1000 && n % 1000 == 0) return std::to_string(n / 1000) + "k" + unit;
+    return std::to_string(n) + unit;
+}
+
+static void addKeyValueBenchmarks(MicroBenchmarkSuite& suite) {
+    RedisDatabase& db = RedisDatabase::getInstance();
+
+    for (size_t valueSize : {16, 256, 4096}) {
+        auto value = std::make_shared<std::string>(valueSize, 'v');
+        // Every key exists beforehand: SET overwrites and the tables keep their size
+        auto fill = [&db, value](int threads, uint64_t) {
+            db.flushAll();
+            prepareKeys(threads);
+            for (int t = 0; t < threads; t++) {
+                for (const auto& key : keysOf(t)) db.set(key, *value);
+            }
+        };
+        suite.add({"set", sizeLabel(valueSize, "B"), true, fill, [&db, value](int t, uint64_t begin, uint64_t end) {
+            const auto& keys = keysOf(t);
+            for (uint64_t i = begin; i < end; i++) db.set(keys[i & (KEYS_PER_THREAD - 1)], *value);
+        }, nullptr});
+        suite.add({"get", sizeLabel(valueSize, "B"), true, fill, [&db](int t, uint64_t begin, uint64_t end) {
+            const auto& keys = keysOf(t);
+            std::string out;
+            for (uint64_t i = begin; i < end; i++) db.get(keys[i & (KEYS_PER_THREAD - 1)], out);
+        }, nullptr});
+    }
+}
+
+static void addListBenchmarks(MicroBenchmarkSuite& suite) {
+    RedisDatabase& db = RedisDatabase::getInstance();
+    // Each thread pushes to and pops from its own lists
+    static const size_t LISTS = 64;
+
+    for (size_t valueSize : {16, 256}) {
+        auto value = std::make_shared<std::string>(valueSize, 'v');
+        suite.add({"lpush", sizeLabel(valueSize, "B"), true,
+                   [&db](int threads, uint64_t) {
+            db.flushAll();
+            prepareKeys(threads);
+        },
+                   [&db, value](int t, uint64_t begin, uint64_t end) {
+            const auto& keys = keysOf(t);
+            std::string_view item = *value;
+            for (uint64_t i = begin; i < end; i++) db.lpush(keys[i % LISTS], &item, 1);
+        }, nullptr});
+        // Every pop finds an element
+        suite.add({"lpop", sizeLabel(valueSize, "B"), true,
+                   [&db, value](int threads, uint64_t ops) {
+            db.flushAll();
+            prepareKeys(threads);
+            std::string_view item = *value;
+            for (int t = 0; t < threads; t++) {
+                const auto& keys = keysOf(t);
+                for (uint64_t i = 0; i < ops; i++) db.lpush(keys[i % LISTS], &item, 1);
+            }
+        }, [&db](int t, uint64_t begin, uint64_t end) {
+            const auto& keys = keysOf(t);
+            std::string out;
+            for (uint64_t i = begin; i < end; i++) db.lpop(keys[i % LISTS], out);
+        }, nullptr});
+    }
+}
+
+static void addHashBenchmarks(MicroBenchmarkSuite& suite) {
+    RedisDatabase& db = RedisDatabase::getInstance();
+    // Small hashes stay listpacks; the large ones are hash tables
+    static const size_t HASHES = 64;
+
+    for (size_t fields : {16, 1024}) {
+        auto fieldNames = std::make_shared<std::vector<std::string>>();
+        for (size_t f = 0; f < fields; f++) fieldNames->push_back("field:" + std::to_string(f));
+        auto fill = [&db, fieldNames](int threads, uint64_t) {
+            db.flushAll();
+            prepareKeys(threads);
+            for (int t = 0; t < threads; t++) {
+                const auto& keys = keysOf(t);
+                for (size_t h = 0; h < HASHES; h++) {
+                    for (const auto& field : *fieldNames) db.hset(keys[h], field, "value");
+                }
+            }
+        };
+        suite.add({"hset", sizeLabel(fields, " fields"), true, fill,
+                   [&db, fieldNames](int t, uint64_t begin, uint64_t end) {
+            const auto& keys = keysOf(t);
+            const auto& names = *fieldNames;
+            for (uint64_t i = begin; i < end; i++) db.hset(keys[i % HASHES], names[(i / HASHES) % names.size()], "value");
+        }, nullptr});
+        suite.add({"hgetall", sizeLabel(fields, " fields"), true, fill, [&db](int t, uint64_t begin, uint64_t end) {
+            const auto& keys = keysOf(t);
+            for (uint64_t i = begin; i < end; i++) db.hgetall(keys[i % HASHES]);
+        }, nullptr});
+    }
+}
+
+static void addKeyspaceBenchmarks(MicroBenchmarkSuite& suite) {
+    RedisDatabase& db = RedisDatabase::getInstance();
+
+    for (size_t keyCount : {1000, 100000}) {
+        auto fill = [&db, keyCount] {
+            db.flushAll();
+            for (size_t i = 0; i < keyCount; i++) db.set("key:" + std::to_string(i), "0123456789abcdef");
+        };
+        suite.add({"keys", sizeLabel(keyCount, " keys"), true, [fill](int, uint64_t) { fill(); },
+                   [&db](int, uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; i++) db.keys();
+        }, nullptr});
+        suite.add({"dump", sizeLabel(keyCount, " keys"), false, [fill](int, uint64_t) { fill(); },
+                   [&db](int, uint64_t begin, uint64_t end) {
+            QuietStdout quiet;
+            for (uint64_t i = begin; i < end; i++) db.dump(snapshotFile);
+        }, nullptr});
+        suite.add({"load", sizeLabel(keyCount, " keys"), false, [&db, fill](int, uint64_t) {
+            fill();
+            QuietStdout quiet;
+            db.dump(snapshotFile);
+        }, [&db](int, uint64_t, uint64_t) {
+            QuietStdout quiet;
+            db.load(snapshotFile);
+        }, [&db] { db.flushAll(); }});
+    }
+}
+
+static void addParserBenchmarks(MicroBenchmarkSuite& suite) {
+    auto command = [](size_t args, size_t argSize) {
+        auto out = std::make_shared<std::string>("*" + std::to_string(args + 1) + "\r\n$3\r\nSET\r\n");
+        std::string arg(argSize, 'a');
+        for (size_t i = 0; i < args; i++) *out += "$" + std::to_string(argSize) + "\r\n" + arg + "\r\n";
+        return out;
+    };
+    struct Shape { size_t args, argSize; const char* label; };
+    for (Shape shape : {Shape{2, 16, "3x16B"}, Shape{2, 4096, "3x4kB"}, Shape{100, 16, "101x16B"}}) {
+        auto raw = command(shape.args, shape.argSize);
+        suite.add({"parse", shape.label, true, nullptr, [raw](int, uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; i++) {
+                auto tokens = parseRespCommand(*raw);
+                if (tokens.empty()) std::abort();
+            }
+        }, nullptr});
+    }
+}
+
+int main(int argc, char* argv[]) {
+    MicroBenchmarkSuite suite;
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    suite.threadCounts = {1};
+    if (cores > 1) suite.threadCounts.push_back(static_cast<int>(cores));
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option " << opt << "\n";
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (opt == "--filter") {
+                suite.filter = value;
+            } else if (opt == "--threads") {
+                suite.threadCounts.clear();
+                std::stringstream ss(value);
+                std::string item;
+                while (std::getline(ss, item, ',')) {
+                    int n = std::stoi(item);
+                    if (n < 1) throw std::invalid_argument(value);
+                    suite.threadCounts.push_back(n);
+                }
+            } else if (opt == "--min-time") {
+                suite.minTimeNs = std::stoull(value) * 1000000;
+            } else if (opt == "--repetitions") {
+                suite.repetitions = std::max(1, std::stoi(value));
+            } else if (opt == "--format") {
+                if (value != "text" && value != "csv") throw std::invalid_argument(value);
+                suite.csv = value == "csv";
+            } else {
+                std::cerr << "Unknown option " << opt << "\n";
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for option " << opt << ": " << value << "\n";
+            return 1;
+        }
+    }
+
+    addKeyValueBenchmarks(suite);
+    addListBenchmarks(suite);
+    addHashBenchmarks(suite);
+    addKeyspaceBenchmarks(suite);
+    addParserBenchmarks(suite);
+    suite.runAll();
+    unlink(snapshotFile.c_str());
+    return 0;
+}
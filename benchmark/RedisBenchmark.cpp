@@ -0,0 +1,522 @@
+// my_redis_benchmark: multi-threaded RESP load generator for my_redis_server.
+//
+// Each thread drives its share of the connections with poll(). In closed
+// loop (the default) a connection sends `--pipeline` requests in one write,
+// waits for all the replies and sends the next batch, so the load follows
+// the server's speed. In open loop (`--rate`) requests are scheduled at
+// fixed intervals whether or not the server keeps up, and latency is
+// measured from the scheduled time rather than the actual send, so a stall
+// shows up in every request it delayed (no coordinated omission).
+//
+// Usage: my_redis_benchmark [--option value ...]; see printUsage().
+
+#include "LatencyHistogram.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+enum Command { GET, SET, LPUSH, LPOP, HSET, HGETALL, COMMAND_COUNT };
+static const char* const COMMAND_NAMES[COMMAND_COUNT] = {"get", "set", "lpush", "lpop", "hset", "hgetall"};
+
+struct BenchmarkConfig {
+    std::string host = "127.0.0.1";
+    int port = 6379;
+    int connections = 50;
+    int threads = 0;                // 0: one per core, at most one per connection
+    int pipeline = 1;               // Requests per batch (closed loop) or in flight (open loop)
+    uint64_t requests = 0;          // Stop after this many; 0: run for `duration`
+    double duration = 10;           // Seconds
+    uint64_t keyspace = 100000;     // Distinct keys of each type
+    size_t valueMin = 64;           // Value sizes are uniform in [valueMin, valueMax]
+    size_t valueMax = 64;
+    int hashFields = 16;            // Distinct fields per hash
+    double rate = 0;                // Requests per second in total; 0: closed loop
+    std::string format = "text";    // text, json or csv
+    unsigned weights[COMMAND_COUNT] = {50, 50, 0, 0, 0, 0};
+
+    bool parseArgs(int argc, char* argv[]);
+};
+
+static void printUsage() {
+    std::cout <<
+        "Usage: my_redis_benchmark [--option value ...]\n"
+        "  --host HOST             Server address (127.0.0.1)\n"
+        "  --port PORT             Server port (6379)\n"
+        "  --connections N         Connections in total (50)\n"
+        "  --threads N             Client threads (one per core)\n"
+        "  --pipeline N            Requests per batch; in open loop, most in flight per connection (1)\n"
+        "  --requests N            Stop after N requests (default: run for --duration)\n"
+        "  --duration SECONDS      Length of the run (10)\n"
+        "  --keyspace N            Distinct keys of each type (100000)\n"
+        "  --value-size N|MIN-MAX  Value bytes, fixed or uniformly distributed (64)\n"
+        "  --hash-fields N         Distinct fields per hash (16)\n"
+        "  --mix CMD=W,...         Weighted mix of get, set, lpush, lpop, hset, hgetall (get=50,set=50)\n"
+        "  --rate OPS              Open loop at OPS requests per second in total (default: closed loop)\n"
+        "  --format text|json|csv  Report format (text)\n";
+}
+
+// "get=50,set=30,hgetall=20"
+static bool parseMix(const std::string& value, unsigned* weights) {
+    std::fill(weights, weights + COMMAND_COUNT, 0u);
+    std::stringstream ss(value);
+    std::string item;
+    unsigned total = 0;
+    while (std::getline(ss, item, ',')) {
+        size_t eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        for (auto& c : name) c = std::tolower(static_cast<unsigned char>(c));
+        auto it = std::find_if(COMMAND_NAMES, COMMAND_NAMES + COMMAND_COUNT,
+                               [&](const char* n) { return name == n; });
+        if (it == COMMAND_NAMES + COMMAND_COUNT) return false;
+        unsigned weight = eq == std::string::npos ? 1 : std::stoul(item.substr(eq + 1));
+        weights[it - COMMAND_NAMES] = weight;
+        total += weight;
+    }
+    return total > 0;
+}
+
+bool BenchmarkConfig::parseArgs(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "--help") {
+            printUsage();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option " << opt << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (opt == "--host") {
+                host = value;
+            } else if (opt == "--port") {
+                port = std::stoi(value);
+            } else if (opt == "--connections") {
+                connections = std::stoi(value);
+                if (connections < 1) throw std::invalid_argument(value);
+            } else if (opt == "--threads") {
+                threads = std::stoi(value);
+            } else if (opt == "--pipeline") {
+                pipeline = std::stoi(value);
+                if (pipeline < 1) throw std::invalid_argument(value);
+            } else if (opt == "--requests") {
+                requests = std::stoull(value);
+            } else if (opt == "--duration") {
+                duration = std::stod(value);
+            } else if (opt == "--keyspace") {
+                keyspace = std::stoull(value);
+                if (keyspace == 0) throw std::invalid_argument(value);
+            } else if (opt == "--value-size") {
+                size_t dash = value.find('-');
+                valueMin = std::stoul(value.substr(0, dash));
+                valueMax = dash == std::string::npos ? valueMin : std::stoul(value.substr(dash + 1));
+                if (valueMax < valueMin) throw std::invalid_argument(value);
+            } else if (opt == "--hash-fields") {
+                hashFields = std::stoi(value);
+                if (hashFields < 1) throw std::invalid_argument(value);
+            } else if (opt == "--mix") {
+                if (!parseMix(value, weights)) throw std::invalid_argument(value);
+            } else if (opt == "--rate") {
+                rate = std::stod(value);
+            } else if (opt == "--format") {
+                if (value != "text" && value != "json" && value != "csv") throw std::invalid_argument(value);
+                format = value;
+            } else {
+                std::cerr << "Unknown option " << opt << "\n";
+                printUsage();
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for option " << opt << ": " << value << "\n";
+            return false;
+        }
+    }
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, connections);
+    return true;
+}
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Length of the complete RESP reply at the start of `data`, 0 if more bytes
+// are needed, -1 if it is malformed. `error` is set for an error reply.
+static long replyLength(std::string_view data, bool& error) {
+    if (data.empty()) return 0;
+    size_t eol = data.find("\r\n");
+    if (eol == std::string_view::npos) return 0;
+    long header = static_cast<long>(eol + 2);
+    switch (data[0]) {
+        case '+':
+        case ':':
+            return header;
+        case '-':
+            error = true;
+            return header;
+        case '$': {
+            long len = std::strtol(data.data() + 1, nullptr, 10);
+            if (len < 0) return header;
+            long total = header + len + 2;
+            return static_cast<long>(data.size()) >= total ? total : 0;
+        }
+        case '*': {
+            long count = std::strtol(data.data() + 1, nullptr, 10);
+            long total = header;
+            for (long i = 0; i < count; i++) {
+                long n = replyLength(data.substr(total), error);
+                if (n <= 0) return n;
+                total += n;
+            }
+            return total;
+        }
+        default:
+            return -1;
+    }
+}
+
+static void appendBulk(std::string& out, std::string_view arg) {
+    out += '$';
+    out += std::to_string(arg.size());
+    out += "\r\n";
+    out.append(arg.data(), arg.size());
+    out += "\r\n";
+}
+
+struct ThreadResult {
+    LatencyHistogram all;
+    LatencyHistogram perCommand[COMMAND_COUNT];
+    uint64_t errors = 0;
+    uint64_t lastReplyNs = 0;
+    bool failed = false;
+};
+
+class BenchmarkThread {
+public:
+    BenchmarkThread(const BenchmarkConfig& config, int connections, uint64_t seed,
+                    const std::string& payload, std::atomic<int64_t>& budget)
+        : config(config), conns(connections), rng(seed), payload(payload), budget(budget) {
+        for (int i = 0; i < COMMAND_COUNT; i++) totalWeight += config.weights[i];
+    }
+
+    void run(uint64_t startNs, uint64_t endNs, ThreadResult& result);
+
+private:
+    struct Pending {
+        Command command;
+        uint64_t startNs;
+    };
+    struct Connection {
+        int fd = -1;
+        std::string out;
+        size_t outSent = 0;
+        std::string in;
+        std::deque<Pending> inflight;
+        uint64_t nextSendNs = 0;    // Open loop: scheduled time of the next request
+    };
+
+    bool connect(Connection& conn);
+    bool claimRequest() { return budget.fetch_sub(1) > 0; }
+    void appendRequest(Connection& conn, uint64_t startNs);
+    bool readReplies(Connection& conn, ThreadResult& result);
+    bool writePending(Connection& conn);
+
+    const BenchmarkConfig& config;
+    std::vector<Connection> conns;
+    std::mt19937_64 rng;
+    const std::string& payload;
+    std::atomic<int64_t>& budget;
+    unsigned totalWeight = 0;
+    std::vector<std::string_view> args;
+};
+
+bool BenchmarkThread::connect(Connection& conn) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    if (getaddrinfo(config.host.c_str(), std::to_string(config.port).c_str(), &hints, &addrs) != 0) return false;
+    for (addrinfo* a = addrs; a; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            conn.fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(addrs);
+    return conn.fd >= 0;
+}
+
+void BenchmarkThread::appendRequest(Connection& conn, uint64_t startNs) {
+    // Pick the command by weight, then its key and arguments
+    unsigned pick = rng() % totalWeight;
+    int c = 0;
+    while (pick >= config.weights[c]) pick -= config.weights[c++];
+    Command command = static_cast<Command>(c);
+
+    char key[32], field[32];
+    uint64_t n = rng() % config.keyspace;
+    const char* prefix = command <= SET ? "key:" : command <= LPOP ? "list:" : "hash:";
+    std::string_view keyView(key, snprintf(key, sizeof(key), "%s%012llu", prefix, static_cast<unsigned long long>(n)));
+    size_t valueSize = config.valueMin + rng() % (config.valueMax - config.valueMin + 1);
+    std::string_view value(payload.data(), valueSize);
+
+    args.clear();
+    args.push_back(COMMAND_NAMES[command]);
+    args.push_back(keyView);
+    if (command == SET || command == LPUSH) {
+        args.push_back(value);
+    } else if (command == HSET) {
+        int f = static_cast<int>(rng() % config.hashFields);
+        args.push_back(std::string_view(field, snprintf(field, sizeof(field), "field:%d", f)));
+        args.push_back(value);
+    }
+
+    conn.out += '*';
+    conn.out += std::to_string(args.size());
+    conn.out += "\r\n";
+    for (auto arg : args) appendBulk(conn.out, arg);
+    conn.inflight.push_back({command, startNs});
+}
+
+bool BenchmarkThread::writePending(Connection& conn) {
+    while (conn.outSent < conn.out.size()) {
+        ssize_t n = ::send(conn.fd, conn.out.data() + conn.outSent, conn.out.size() - conn.outSent, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        conn.outSent += n;
+    }
+    conn.out.clear();
+    conn.outSent = 0;
+    return true;
+}
+
+bool BenchmarkThread::readReplies(Connection& conn, ThreadResult& result) {
+    char buf[64 * 1024];
+    ssize_t n = ::recv(conn.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    conn.in.append(buf, n);
+
+    uint64_t now = nowNs();
+    size_t pos = 0;
+    while (!conn.inflight.empty()) {
+        bool error = false;
+        long len = replyLength(std::string_view(conn.in).substr(pos), error);
+        if (len < 0) return false;
+        if (len == 0) break;
+        pos += len;
+        Pending done = conn.inflight.front();
+        conn.inflight.pop_front();
+        uint64_t latency = now - done.startNs;
+        result.all.record(latency);
+        result.perCommand[done.command].record(latency);
+        if (error) result.errors++;
+        result.lastReplyNs = now;
+    }
+    conn.in.erase(0, pos);
+    return true;
+}
+
+void BenchmarkThread::run(uint64_t startNs, uint64_t endNs, ThreadResult& result) {
+    for (auto& conn : conns) {
+        if (!connect(conn)) {
+            std::cerr << "Could not connect to " << config.host << ":" << config.port << "\n";
+            result.failed = true;
+            return;
+        }
+    }
+    // Spread each connection's share of the rate evenly, staggered
+    uint64_t intervalNs = config.rate > 0 ? static_cast<uint64_t>(1e9 * config.connections / config.rate) : 0;
+    for (size_t i = 0; i < conns.size(); i++) conns[i].nextSendNs = startNs + intervalNs * i / conns.size();
+
+    std::vector<pollfd> fds(conns.size());
+    bool sending = true;
+    while (true) {
+        uint64_t now = nowNs();
+        if (sending && now >= endNs) sending = false;
+
+        bool busy = false;
+        uint64_t wakeNs = UINT64_MAX;
+        for (auto& conn : conns) {
+            if (sending) {
+                if (intervalNs == 0) {
+                    // Closed loop: next batch once the previous one is answered
+                    if (conn.inflight.empty()) {
+                        for (int i = 0; i < config.pipeline && (sending = claimRequest()); i++) {
+                            appendRequest(conn, now);
+                        }
+                    }
+                } else {
+                    while (conn.nextSendNs <= now && conn.inflight.size() < static_cast<size_t>(config.pipeline) &&
+                           (sending = claimRequest())) {
+                        appendRequest(conn, conn.nextSendNs);
+                        conn.nextSendNs += intervalNs;
+                    }
+                    wakeNs = std::min(wakeNs, conn.nextSendNs);
+                }
+            }
+            if (!writePending(conn)) {
+                std::cerr << "Connection lost: " << strerror(errno) << "\n";
+                result.failed = true;
+                return;
+            }
+            busy |= !conn.inflight.empty();
+        }
+        if (!sending && !busy) break;
+
+        for (size_t i = 0; i < conns.size(); i++) {
+            fds[i].fd = conns[i].fd;
+            fds[i].events = POLLIN | (conns[i].out.empty() ? 0 : POLLOUT);
+            fds[i].revents = 0;
+        }
+        // Wake up for the next scheduled send, or now and then to check the clock
+        uint64_t waitNs = 100 * 1000000ull;
+        if (sending && wakeNs != UINT64_MAX) waitNs = std::min(waitNs, wakeNs > now ? wakeNs - now : 0);
+        timespec timeout{static_cast<time_t>(waitNs / 1000000000), static_cast<long>(waitNs % 1000000000)};
+        if (ppoll(fds.data(), fds.size(), &timeout, nullptr) < 0 && errno != EINTR) break;
+
+        for (size_t i = 0; i < conns.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLERR | POLLHUP))) continue;
+            if (!readReplies(conns[i], result)) {
+                std::cerr << "Connection closed by server\n";
+                result.failed = true;
+                return;
+            }
+        }
+    }
+    for (auto& conn : conns) close(conn.fd);
+}
+
+static void printHistogramJson(std::ostream& out, const LatencyHistogram& h) {
+    out << "{\"calls\":" << h.count()
+        << ",\"mean_us\":" << h.mean() / 1000
+        << ",\"p50_us\":" << h.percentile(50) / 1000.0
+        << ",\"p99_us\":" << h.percentile(99) / 1000.0
+        << ",\"p999_us\":" << h.percentile(99.9) / 1000.0
+        << ",\"max_us\":" << h.max() / 1000.0 << "}";
+}
+
+static void report(const BenchmarkConfig& config, const ThreadResult& total, double seconds) {
+    double throughput = seconds > 0 ? total.all.count() / seconds : 0;
+    std::ostream& out = std::cout;
+    out << std::fixed << std::setprecision(2);
+
+    std::vector<std::pair<std::string, const LatencyHistogram*>> rows;
+    for (int c = 0; c < COMMAND_COUNT; c++) {
+        if (total.perCommand[c].count()) rows.push_back({COMMAND_NAMES[c], &total.perCommand[c]});
+    }
+    rows.push_back({"all", &total.all});
+
+    if (config.format == "json") {
+        out << "{\"connections\":" << config.connections
+            << ",\"threads\":" << config.threads
+            << ",\"pipeline\":" << config.pipeline
+            << ",\"keyspace\":" << config.keyspace
+            << ",\"value_min\":" << config.valueMin
+            << ",\"value_max\":" << config.valueMax
+            << ",\"rate\":" << config.rate
+            << ",\"seconds\":" << seconds
+            << ",\"requests\":" << total.all.count()
+            << ",\"errors\":" << total.errors
+            << ",\"ops_per_sec\":" << throughput
+            << ",\"latency\":{";
+        for (size_t i = 0; i < rows.size(); i++) {
+            out << (i ? "," : "") << "\"" << rows[i].first << "\":";
+            printHistogramJson(out, *rows[i].second);
+        }
+        out << "}}\n";
+        return;
+    }
+    if (config.format == "csv") {
+        out << "command,calls,ops_per_sec,mean_us,p50_us,p99_us,p999_us,max_us\n";
+        for (const auto& row : rows) {
+            const LatencyHistogram& h = *row.second;
+            out << row.first << "," << h.count() << "," << (seconds > 0 ? h.count() / seconds : 0) << ","
+                << h.mean() / 1000 << "," << h.percentile(50) / 1000.0 << "," << h.percentile(99) / 1000.0 << ","
+                << h.percentile(99.9) / 1000.0 << "," << h.max() / 1000.0 << "\n";
+        }
+        return;
+    }
+
+    out << total.all.count() << " requests in " << seconds << " s, " << total.errors << " errors\n"
+        << config.connections << " connections on " << config.threads << " threads, pipeline " << config.pipeline
+        << (config.rate > 0 ? ", open loop" : ", closed loop") << "\n"
+        << "Throughput: " << throughput << " requests/s\n\n"
+        << std::left << std::setw(9) << "command" << std::right << std::setw(12) << "calls"
+        << std::setw(12) << "mean(us)" << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+        << std::setw(12) << "p99.9(us)" << std::setw(12) << "max(us)" << "\n";
+    for (const auto& row : rows) {
+        const LatencyHistogram& h = *row.second;
+        out << std::left << std::setw(9) << row.first << std::right << std::setw(12) << h.count()
+            << std::setw(12) << h.mean() / 1000 << std::setw(12) << h.percentile(50) / 1000.0
+            << std::setw(12) << h.percentile(99) / 1000.0 << std::setw(12) << h.percentile(99.9) / 1000.0
+            << std::setw(12) << h.max() / 1000.0 << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    if (!config.parseArgs(argc, argv)) return 1;
+
+    std::string payload(config.valueMax, 'x');
+    std::mt19937 fill(42);
+    for (auto& c : payload) c = static_cast<char>('a' + fill() % 26);
+
+    // Requests left to send; effectively unlimited when running for a duration
+    std::atomic<int64_t> budget(config.requests ? static_cast<int64_t>(config.requests) : INT64_MAX);
+    std::vector<std::unique_ptr<BenchmarkThread>> workers;
+    for (int t = 0; t < config.threads; t++) {
+        int share = config.connections / config.threads + (t < config.connections % config.threads ? 1 : 0);
+        workers.push_back(std::make_unique<BenchmarkThread>(config, share, 1000003ull * (t + 1), payload, budget));
+    }
+
+    std::vector<ThreadResult> results(config.threads);
+    uint64_t startNs = nowNs();
+    uint64_t endNs = config.requests ? UINT64_MAX : startNs + static_cast<uint64_t>(config.duration * 1e9);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < config.threads; t++) {
+        threads.emplace_back(&BenchmarkThread::run, workers[t].get(), startNs, endNs, std::ref(results[t]));
+    }
+    for (auto& t : threads) t.join();
+
+    ThreadResult total;
+    for (const auto& r : results) {
+        if (r.failed) return 1;
+        total.all.merge(r.all);
+        for (int c = 0; c < COMMAND_COUNT; c++) total.perCommand[c].merge(r.perCommand[c]);
+        total.errors += r.errors;
+        total.lastReplyNs = std::max(total.lastReplyNs, r.lastReplyNs);
+    }
+    report(config, total, total.lastReplyNs > startNs ? (total.lastReplyNs - startNs) / 1e9 : 0);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#ifndef APPEND_ONLY_FILE_H
+#define APPEND_ONLY_FILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+#include "Keyspace.h"
+
+class RedisCommandHandler;
+
+// Append-only log of the write commands, in RESP, replayed at startup.
+//
+// Commands are queued in memory as they execute. Each event loop calls
+// flush() once per iteration, before sending that iteration's replies:
+// whatever every reactor queued so far goes to the file in one write()
+// (group commit). A dedicated thread does the fsyncs:
+//   always    flush() waits until its commands are on disk; concurrent
+//             flushes share one fsync
+//   everysec  fsync about once a second; flush() never waits for the disk
+//   no        never fsync; the kernel decides
+//
+// The log is compacted by backgroundRewrite(), by hand (BGREWRITEAOF) or
+// once it has grown past the auto-rewrite thresholds.
+class AppendOnlyFile {
+public:
+    enum class FsyncPolicy { Always, EverySec, No };
+
+    static AppendOnlyFile& getInstance();
+
+    // Open `filename` for appending and start the fsync thread
+    bool open(const std::string& filename, FsyncPolicy policy);
+    bool isOpen() const { return fd >= 0; }
+    // Flush, fsync and stop logging (shutdown)
+    void close();
+
+    // Queue a command. Returns its end offset in the log. The keyspace
+    // feeds each change from inside the shard lock covering it (see
+    // RedisDatabase::Propagation), so the log order is the order in which
+    // writes reached each shard.
+    uint64_t feed(const std::string_view* args, size_t count);
+    // Write everything queued so far. Under `always`, returns once the log
+    // is on disk up to `offset`. Returns false on a write error.
+    bool flush(uint64_t offset);
+
+    // Compact the log: a forked child writes the commands recreating the
+    // current keyspace to a new file while writes keep going to the old one
+    // and are also buffered. Once the child is done, the buffer is appended
+    // to the new file, which is renamed over the old one. Returns false if
+    // the log is closed, a rewrite is already running or fork() fails.
+    bool backgroundRewrite();
+    // Start a rewrite if the log has grown past the configured percentage
+    // of its size after the last rewrite (and past the minimum size)
+    void rewriteIfGrown();
+
+    struct RewriteStatus {
+        bool inProgress = false;
+        bool lastOk = true;
+        int64_t lastDurationMs = -1;
+        uint64_t size = 0;          // Current log size in bytes
+        uint64_t baseSize = 0;      // Size at startup or after the last rewrite
+    };
+    RewriteStatus rewriteStatus() const;
+
+    // Replay the log through `handler`. A command cut short by a crash at
+    // the end of the file is dropped and the file truncated before it.
+    static bool load(const std::string& filename, RedisCommandHandler& handler);
+
+private:
+    AppendOnlyFile() = default;
+    ~AppendOnlyFile() = default;
+    AppendOnlyFile(const AppendOnlyFile&) = delete;
+    AppendOnlyFile& operator = (const AppendOnlyFile&) = delete;
+
+    void fsyncLoop();
+    // Append `data` to the file (writeMtx held)
+    bool writeData(const std::string& data);
+    // Wait for the rewrite child and install its file if it succeeded
+    void finishRewrite(pid_t pid, std::string tmpname, int64_t startedAtMs);
+    bool installRewrite(const std::string& tmpname);
+
+    std::atomic<int> fd{-1};    // Replaced when a rewrite is installed
+    std::string filename;
+    FsyncPolicy policy = FsyncPolicy::EverySec;
+    std::atomic<uint64_t> fileSize{0};
+    std::atomic<uint64_t> baseSize{0};
+
+    std::mutex queueMtx;        // Guards queue and queued
+    std::string queue;          // Commands not yet written
+    uint64_t queued = 0;        // Log offset at the end of queue
+    bool rewriting = false;     // A rewrite child is running...
+    std::string rewriteBuf;     // ...and these commands were fed since it forked
+
+    mutable std::mutex rewriteMtx;  // Guards the rewrite state below
+    pid_t rewriteChild = -1;
+    bool lastRewriteOk = true;
+    int64_t lastRewriteDurationMs = -1;
+
+    std::mutex writeMtx;        // Serializes writers so the file keeps queue order
+    std::mutex syncMtx;         // Guards the fields below
+    std::condition_variable syncCond;
+    uint64_t written = 0;       // Bytes written to the file
+    uint64_t synced = 0;        // Bytes known to be on disk
+    bool syncing = false;       // The fsync thread is inside fdatasync()
+    bool stopping = false;
+    std::thread fsyncThread;
+};
+
+// RESP encoding of one command, as stored in the log
+void encodeAofCommand(std::string& out, const std::string_view* args, size_t count);
+// Commands that recreate `entry` (SET / RPUSH / HSET, then PEXPIREAT if it
+// has a TTL). `expireAtMs` is the deadline in Unix ms, 0 for none.
+void encodeAofEntry(std::string& out, const KeyEntry& entry, int64_t expireAtMs);
+
+#endif
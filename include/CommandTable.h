@@ -0,0 +1,46 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class RedisDatabase;
+class ReplyBuffer;
+
+// Command flags
+enum CommandFlags : uint32_t {
+    CMD_WRITE    = 1 << 0,  // May modify the keyspace
+    CMD_READONLY = 1 << 1,  // Only reads the keyspace
+    CMD_FAST     = 1 << 2,  // O(1) or O(log N); never scans a whole value or the keyspace
+    CMD_DENYOOM  = 1 << 3,  // May add data; refused when over maxmemory and nothing can be evicted
+};
+
+using CommandProc = void (*)(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+
+// Static description of one command.
+struct RedisCommand {
+    const char* name;   // Lower case
+    CommandProc proc;
+    int arity;          // N: exactly N tokens including the name; -N: at least N
+    uint32_t flags;     // CommandFlags
+    int firstKey;       // Position of the first key argument (0: no keys)
+    int lastKey;        // Position of the last key argument (negative: counted from the end)
+    int keyStep;        // Distance between key arguments
+
+    bool checkArity(size_t argc) const {
+        return arity >= 0 ? argc == static_cast<size_t>(arity) : argc >= static_cast<size_t>(-arity);
+    }
+};
+
+// Case-insensitive, constant-time lookup. Returns nullptr for unknown commands.
+const RedisCommand* lookupCommand(std::string_view name);
+
+// Commands are numbered by their position in the table (0 to
+// commandCount() - 1) so per-command statistics can live in flat arrays.
+size_t commandCount();
+size_t commandId(const RedisCommand* command);
+const RedisCommand& commandById(size_t id);
+
+#endif
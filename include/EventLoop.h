@@ -0,0 +1,60 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "RespParser.h"
+#include "ReplyBuffer.h"
+
+class RedisCommandHandler;
+
+// Per-connection state. The event loop owns one of these for every
+// accepted client; an idle connection costs this struct plus its buffers.
+struct Connection {
+    int fd;
+    std::string addr;       // "ip:port" of the client
+    std::string inbuf;      // Bytes received but not yet processed; freed once all are
+    RespParser parser;      // Parse position within inbuf
+    std::vector<std::string_view> args; // Arguments of the command being run (views into inbuf)
+    ReplyBuffer reply;      // Replies not yet written to the socket
+    bool readPaused = false; // Output backlog too large: stop reading until the client catches up
+    bool flushPending = false; // Holds replies to logged writes until the append only file is written
+    bool peerClosed = false; // Client shut its side: no more reads, close once its replies are sent
+
+    Connection(int fd, std::string addr) : fd(fd), addr(std::move(addr)) {}
+};
+
+// Edge-triggered epoll reactor. One thread runs the loop and serves every
+// client accepted on the listening socket with non-blocking I/O.
+class EventLoop {
+public:
+    EventLoop(int listen_fd, RedisCommandHandler& cmdHandler);
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator = (const EventLoop&) = delete;
+
+    // Run until `running` becomes false.
+    void run(const std::atomic<bool>& running);
+
+private:
+    void acceptClients();
+    void handleRead(Connection& conn);
+    bool processInput(Connection& conn);
+    bool flushOutput(Connection& conn);
+    bool closeIfDone(Connection& conn);
+    void closeConnection(Connection& conn);
+    void commitPending();
+
+    int epoll_fd;
+    int listen_fd;
+    RedisCommandHandler& cmdHandler;
+    size_t outputLimit;     // Hard cap on a client's unsent replies
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<int> pendingFlush;  // Connections with flushPending set, by fd
+    std::unique_ptr<char[]> readBuf; // Every socket read lands here first
+};
+
+#endif
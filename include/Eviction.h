@@ -0,0 +1,44 @@
+#ifndef EVICTION_H
+#define EVICTION_H
+
+#include <cstdint>
+#include <string>
+#include "Keyspace.h"
+
+// Which keys may be evicted once maxmemory is reached, and in what order
+enum class EvictionPolicy {
+    NoEviction,     // Refuse commands that add data instead
+    AllKeysLru,     // Least recently used of all keys
+    VolatileLru,    // Least recently used of the keys with a TTL
+    AllKeysLfu,     // Least frequently used of all keys
+    VolatileTtl,    // Keys with the nearest expiry
+};
+
+// Parse a maxmemory-policy name ("allkeys-lru"). Returns false if unknown.
+bool parseEvictionPolicy(const std::string& name, EvictionPolicy& policy);
+// The configured policy
+EvictionPolicy evictionPolicy();
+// Whether the policy only evicts keys that have a TTL
+inline bool isVolatilePolicy(EvictionPolicy policy) {
+    return policy == EvictionPolicy::VolatileLru || policy == EvictionPolicy::VolatileTtl;
+}
+
+// KeyEntry::access holds either an LRU clock (the time of the last access
+// in 100 ms ticks, 24 bits) or, under the LFU policies, the time of the
+// last counter decay in minutes (high 16 bits) and a logarithmic access
+// counter (low 8 bits): the counter goes up with probability
+// 1 / ((counter - LFU_INIT_VAL) * lfu-log-factor + 1) on each access and
+// down by one every lfu-decay-time minutes without one.
+static const uint32_t LFU_INIT_VAL = 5;
+
+// Access metadata for a newly created entry
+uint32_t initialAccess(int64_t nowMs);
+// Record an access (any lock held)
+void touchEntry(const KeyEntry& entry, int64_t nowMs);
+// How good a candidate for eviction `entry` is under `policy`; the higher
+// the score the sooner it goes
+uint64_t evictionScore(const KeyEntry& entry, EvictionPolicy policy, int64_t nowMs);
+// Current value of the LFU counter after decay
+uint8_t lfuCounter(const KeyEntry& entry, int64_t nowMs);
+
+#endif
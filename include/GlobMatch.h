@@ -0,0 +1,15 @@
+#ifndef GLOB_MATCH_H
+#define GLOB_MATCH_H
+
+#include <string_view>
+
+// Redis-style glob matching, as used by KEYS, SCAN and HSCAN:
+//   *       any run of characters, including none
+//   ?       any one character
+//   [abc]   one of the listed characters; [^abc] none of them; [a-z] a range
+//   \x      the character x itself
+// Runs in O(pattern * text) at worst: a '*' only ever backtracks to the
+// most recent one, never recursively.
+bool globMatch(std::string_view pattern, std::string_view text);
+
+#endif
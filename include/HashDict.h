@@ -0,0 +1,91 @@
+#ifndef HASH_DICT_H
+#define HASH_DICT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Field -> value table of a large hash. Open addressing with linear
+// probing over a power-of-two slot array, each slot holding the field's
+// full hash next to a pointer to its node, like KeyspaceTable; deleted
+// slots become tombstones until the next resize. The table grows and
+// shrinks in one go: a hash is a single value, and std::unordered_map,
+// which this replaces, rehashed the same way.
+//
+// The power-of-two layout is what makes scan() cursors stateless: HSCAN
+// walks home slots with a reverse-binary cursor, as SCAN does, so a walk
+// stays valid however often the table is resized in between.
+class HashDict {
+public:
+    HashDict() = default;
+    ~HashDict();
+    HashDict(const HashDict&) = delete;
+    HashDict& operator = (const HashDict&) = delete;
+
+    size_t size() const { return used; }
+    // Value of `field`, or nullptr
+    const std::string* find(std::string_view field) const;
+    // Returns 1 if the stored value changed (new field or different value)
+    int set(std::string_view field, std::string_view value);
+    bool erase(std::string_view field);
+    // Make room for `count` fields without resizing along the way
+    void reserve(size_t count);
+
+    // Approximate bytes allocated for the table, its nodes and strings
+    size_t memoryUsage() const;
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const Slot& slot : slots) {
+            if (isLive(slot.node)) fn(std::string_view(slot.node->field), std::string_view(slot.node->value));
+        }
+    }
+
+    // One step of a cursor walk: calls fn(field, value) on the fields whose
+    // home slot is the one `cursor` designates and returns the next cursor,
+    // 0 when the walk is complete. A field present for the whole walk is
+    // seen at least once (it may be seen twice if the table was resized).
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, Fn fn) const {
+        if (used == 0) return 0;
+        uint64_t mask = slots.size() - 1;
+        uint64_t home = cursor & mask;
+        for (size_t i = home, n = 0; slots[i].node != nullptr && n < slots.size(); i = (i + 1) & mask, n++) {
+            if (isLive(slots[i].node) && (slots[i].hash & mask) == home)
+                fn(std::string_view(slots[i].node->field), std::string_view(slots[i].node->value));
+        }
+        // Increment the masked bits of the reversed cursor
+        cursor |= ~mask;
+        cursor = reverseBits(cursor);
+        cursor++;
+        return reverseBits(cursor);
+    }
+
+private:
+    struct Node {
+        std::string field;
+        std::string value;
+    };
+    struct Slot {
+        uint64_t hash = 0;
+        Node* node = nullptr;   // nullptr: empty; TOMBSTONE: deleted
+    };
+    static Node* const TOMBSTONE;
+    static const size_t MIN_CAPACITY = 16;
+    static bool isLive(const Node* node) { return node != nullptr && node != TOMBSTONE; }
+    static uint64_t hashField(std::string_view field);
+    static uint64_t reverseBits(uint64_t v);
+
+    // Slot holding `field`, or NOT_FOUND
+    size_t findSlot(std::string_view field, uint64_t hash) const;
+    // Move every live node to a fresh array of `capacity` slots
+    void resize(size_t capacity);
+
+    std::vector<Slot> slots;
+    size_t used = 0;
+    size_t tombstones = 0;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef HASH_OBJECT_H
+#define HASH_OBJECT_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include "Listpack.h"
+#include "HashDict.h"
+
+// A hash value in one of two encodings. A small hash is a Listpack of
+// alternating fields and values searched linearly, a few bytes per field
+// instead of a table node. It is converted to a HashDict once it holds
+// more than hash-max-listpack-entries fields or a field or value longer
+// than hash-max-listpack-value bytes.
+class HashObject {
+public:
+    enum class Encoding { Listpack, Dict };
+
+    Encoding encoding() const { return dict ? Encoding::Dict : Encoding::Listpack; }
+    size_t size() const { return dict ? dict->size() : packed.size() / 2; }
+    bool empty() const { return size() == 0; }
+
+    bool get(std::string_view field, std::string& value) const;
+    bool exists(std::string_view field) const;
+    // Returns 1 if the stored value changed (new field or different value)
+    int set(std::string_view field, std::string_view value);
+    bool del(std::string_view field);
+
+    // Approximate bytes allocated for the hash, this object included
+    size_t memoryUsage() const;
+
+    // One step of a cursor walk (HSCAN): calls fn(field, value) on about
+    // `count` fields and returns the next cursor, 0 when done. A listpack
+    // is returned whole in one step. For the table the cursor is stateless
+    // (see HashDict::scan): resizes between steps may repeat fields but
+    // never skip one, and the walk always ends.
+    uint64_t scan(uint64_t cursor, size_t count,
+                  const std::function<void(std::string_view, std::string_view)>& fn) const;
+
+    // The listpack while the hash is in the small encoding, else nullptr
+    const Listpack* listpack() const { return dict ? nullptr : &packed; }
+    // Replace the contents with a listpack blob of alternating fields and
+    // values from a snapshot, converting it if it exceeds the current
+    // limits. Returns false if the blob is malformed.
+    bool loadListpack(std::string_view raw);
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        if (dict) {
+            dict->forEach(fn);
+            return;
+        }
+        for (size_t pos = packed.first(); pos != packed.end(); ) {
+            size_t valuePos = packed.next(pos);
+            fn(packed.get(pos), packed.get(valuePos));
+            pos = packed.next(valuePos);
+        }
+    }
+
+private:
+    // Offset of `field` in the listpack, or end()
+    size_t findPacked(std::string_view field) const;
+    void convertToDict();
+
+    Listpack packed;
+    std::unique_ptr<HashDict> dict;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef KEYSPACE_H
+#define KEYSPACE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <variant>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include "ListObject.h"
+#include "HashObject.h"
+#include "Slab.h"
+
+enum class ObjectType : uint8_t { String = 0, List = 1, Hash = 2 };
+
+using RedisList = ListObject;
+using RedisHash = HashObject;
+
+// Name reported by TYPE
+const char* typeName(ObjectType type);
+
+// A value on its way into or out of the keyspace (loading, RENAME)
+using KeyValue = std::variant<std::string, std::unique_ptr<RedisList>, std::unique_ptr<RedisHash>>;
+
+// One key and everything stored for it, in a single allocation: this
+// header, then the value's storage, then the key bytes. A string short
+// enough to fit is embedded in the value storage, which is sized when the
+// entry is created (with the slack of its size class); longer strings and
+// collections hang off a pointer stored there instead. Entries of up to
+// SLAB_MAX_OBJECT bytes come from their table's slab allocator. The expiry
+// deadline and eviction metadata live in the header rather than in
+// separate maps.
+class KeyEntry {
+public:
+    int64_t expireAt = 0;   // Deadline in steady-clock milliseconds; 0 means no TTL
+    // Eviction metadata (LRU clock or LFU counter, see Eviction.h). Updated
+    // by readers under a shared lock, hence atomic.
+    mutable std::atomic<uint32_t> access{0};
+
+    static KeyEntry* create(SlabAllocator& slab, std::string_view key, KeyValue&& value);
+    static void destroy(KeyEntry* entry);
+    // Move the entry to a new chunk of `slab`, freeing the old one (defrag).
+    // Entries hold no pointers into themselves, so a byte copy will do.
+    KeyEntry* relocate(SlabAllocator& slab);
+    bool inSlab() const { return flags & IN_SLAB; }
+
+    std::string_view key() const { return {storage() + valueRoom(), keyLen}; }
+    ObjectType type() const { return tag; }
+    std::string_view str() const;
+    RedisList& list() { return *static_cast<RedisList*>(pointer()); }
+    RedisHash& hash() { return *static_cast<RedisHash*>(pointer()); }
+    const RedisList& list() const { return *static_cast<const RedisList*>(pointer()); }
+    const RedisHash& hash() const { return *static_cast<const RedisHash*>(pointer()); }
+
+    // Store a string value, embedded if it fits (a value of another type is freed)
+    void setString(std::string_view value);
+    // Replace the value with one of any type
+    void setValue(KeyValue&& value);
+    // Hand the value over, leaving an empty string
+    KeyValue takeValue();
+
+    bool isExpired(int64_t nowMs) const { return expireAt != 0 && nowMs > expireAt; }
+    // Approximate bytes used by the entry, its key and its value
+    size_t memoryUsage() const;
+
+private:
+    KeyEntry() = default;
+    ~KeyEntry() = default;
+    KeyEntry(const KeyEntry&) = delete;
+    KeyEntry& operator = (const KeyEntry&) = delete;
+
+    static const uint8_t IN_SLAB = 1;       // Allocated from a slab, not operator new
+    static const uint8_t EMBEDDED = 2;      // The string value is in the value storage
+
+    char* storage() { return reinterpret_cast<char*>(this) + sizeof(KeyEntry); }
+    const char* storage() const { return reinterpret_cast<const char*>(this) + sizeof(KeyEntry); }
+    // Bytes of value storage: the embedded string's room, at least a pointer
+    size_t valueRoom() const { return room > sizeof(void*) ? room : sizeof(void*); }
+    size_t allocationSize() const { return sizeof(KeyEntry) + valueRoom() + keyLen; }
+    void* pointer() const { return *reinterpret_cast<void* const*>(storage()); }
+    void setPointer(void* p) { *reinterpret_cast<void**>(storage()) = p; }
+    // Free the value, leaving an empty string
+    void freeValue();
+
+    uint32_t keyLen = 0;
+    ObjectType tag = ObjectType::String;
+    uint8_t flags = EMBEDDED;
+    uint8_t room = 0;       // Value storage requested for an embedded string
+    uint8_t reserved = 0;
+    uint32_t embeddedLen = 0;
+};
+
+struct KeyEntryDeleter {
+    void operator () (KeyEntry* entry) const { KeyEntry::destroy(entry); }
+};
+// An entry taken out of its table
+using KeyEntryPtr = std::unique_ptr<KeyEntry, KeyEntryDeleter>;
+
+// Hash used for both shard selection and table slots
+uint64_t hashKey(std::string_view key);
+
+// Current steady-clock time in milliseconds, the unit of KeyEntry::expireAt
+int64_t steadyNowMs();
+// Wall-clock milliseconds since the Unix epoch, for anything stored on disk
+int64_t unixNowMs();
+
+// Open-addressing hash table from key to KeyEntry. Each slot holds the
+// key's full hash next to the entry pointer, so a probe compares hashes in
+// one contiguous array and only dereferences an entry on a hash match.
+// Linear probing; deleted slots become tombstones until the next resize.
+//
+// Resizing is incremental: a new slot array is allocated and the old one
+// kept alongside it, and every insert or remove moves a few entries over
+// (rehash() moves more when the shard is idle). Lookups check both arrays
+// until the old one is empty, so no single operation rehashes the table.
+class KeyspaceTable {
+public:
+    KeyspaceTable() : slab(new SlabAllocator()) {}
+    ~KeyspaceTable();
+    KeyspaceTable(const KeyspaceTable&) = delete;
+    KeyspaceTable& operator = (const KeyspaceTable&) = delete;
+
+    KeyEntry* find(std::string_view key, uint64_t hash) const;
+    // Add an entry holding `value` for a key that is not in the table
+    KeyEntry* insert(std::string_view key, uint64_t hash, KeyValue&& value);
+    // Unlink the entry for `key` and hand it to the caller
+    KeyEntryPtr remove(std::string_view key, uint64_t hash);
+    bool erase(std::string_view key, uint64_t hash) { return remove(key, hash) != nullptr; }
+
+    size_t size() const { return used; }
+    void clear();
+    // Exchange contents with `other` in O(1) (FLUSHALL ASYNC detaches a
+    // whole table this way)
+    void swap(KeyspaceTable& other) noexcept;
+    // Make room for `count` keys without resizing along the way
+    void reserve(size_t count);
+
+    // Move entries out of sparse slabs (see SlabAllocator::shouldMove),
+    // visiting up to `count` slots from `cursor` on. Returns the entries
+    // moved; `cursor` goes back to 0 at the end of the table.
+    size_t defrag(size_t& cursor, size_t count);
+    SlabAllocator::Stats slabStats() const { return slab->stats(); }
+
+    // Whether a resize is in progress
+    bool isRehashing() const { return !old.empty(); }
+    // Move up to `count` entries to the new slot array. Returns true if
+    // entries are left to move.
+    bool rehash(size_t count);
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& slot : slots) {
+            if (isLive(slot.entry)) fn(*slot.entry);
+        }
+        for (const auto& slot : old) {
+            if (isLive(slot.entry)) fn(*slot.entry);
+        }
+    }
+
+    // Call fn(entry, hash) on up to `count` entries in consecutive slots
+    // from slot `start` (any number; it wraps), for sampled eviction. The
+    // old array, if any, counts as following the new one.
+    template <typename Fn>
+    void sample(size_t start, size_t count, Fn fn) const {
+        if (used == 0) return;
+        size_t total = slots.size() + old.size();
+        for (size_t i = 0, seen = 0; i < total && seen < count; i++) {
+            size_t n = (start + i) % total;
+            const Slot& slot = n < slots.size() ? slots[n] : old[n - slots.size()];
+            if (!isLive(slot.entry)) continue;
+            fn(*slot.entry, slot.hash);
+            seen++;
+        }
+    }
+
+    // One step of a cursor walk (SCAN). Calls fn(entry) on the entries
+    // whose home slot is the one `cursor` designates, in both arrays during
+    // a resize, and returns the next cursor; 0 when the walk is complete.
+    // The cursor counts home slots with its bits reversed, so an entry
+    // present for the whole walk is seen at least once however often the
+    // table is resized in between (it may be seen twice).
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, Fn fn) const {
+        if (used == 0) return 0;
+        const SlotArray* small = &slots;
+        const SlotArray* large = &old;
+        if (old.empty()) large = nullptr;
+        else if (old.size() < slots.size()) std::swap(small, large);
+
+        uint64_t m0 = small->size() - 1;
+        scanHome(*small, cursor & m0, fn);
+        if (large) {
+            // Every home slot of the larger array that folds onto this one
+            uint64_t m1 = large->size() - 1;
+            do {
+                scanHome(*large, cursor & m1, fn);
+                cursor = (((cursor | m0) + 1) & ~m0) | (cursor & m0);
+            } while (cursor & (m0 ^ m1));
+        }
+        // Increment the masked bits of the reversed cursor
+        cursor |= ~m0;
+        cursor = reverseBits(cursor);
+        cursor++;
+        return reverseBits(cursor);
+    }
+
+private:
+    struct Slot {
+        uint64_t hash;
+        KeyEntry* entry;    // nullptr: empty; TOMBSTONE: deleted or moved
+    };
+    static KeyEntry* const TOMBSTONE;
+    static bool isLive(const KeyEntry* entry) { return entry != nullptr && entry != TOMBSTONE; }
+
+    // Fixed-size array of slots, all empty when created. It is not zeroed
+    // by hand: fresh pages from the allocator already are, so allocating
+    // even a huge array is immediate and its pages are touched as slots get
+    // used instead of all at once in the middle of a resize.
+    class SlotArray {
+    public:
+        SlotArray() = default;
+        explicit SlotArray(size_t count);
+        ~SlotArray();
+        SlotArray(SlotArray&& other) noexcept { swap(other); }
+        SlotArray& operator = (SlotArray&& other) noexcept { swap(other); return *this; }
+        void swap(SlotArray& other) noexcept {
+            std::swap(data, other.data);
+            std::swap(count, other.count);
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        Slot& operator [] (size_t i) { return data[i]; }
+        const Slot& operator [] (size_t i) const { return data[i]; }
+        const Slot* begin() const { return data; }
+        const Slot* end() const { return data + count; }
+        Slot* begin() { return data; }
+        Slot* end() { return data + count; }
+
+    private:
+        Slot* data = nullptr;
+        size_t count = 0;
+    };
+
+    static size_t findSlot(const SlotArray& table, std::string_view key, uint64_t hash);
+    static uint64_t reverseBits(uint64_t v);
+
+    // Entries whose home slot is `home`: they sit between it and the next
+    // empty slot
+    template <typename Fn>
+    static void scanHome(const SlotArray& table, size_t home, Fn& fn) {
+        size_t mask = table.size() - 1;
+        for (size_t i = home, n = 0; table[i].entry != nullptr && n < table.size(); i = (i + 1) & mask, n++) {
+            if (isLive(table[i].entry) && (table[i].hash & mask) == home) fn(*table[i].entry);
+        }
+    }
+    // Start moving the entries to a new array of `capacity` slots (a power of two)
+    void startResize(size_t capacity);
+    // Put a moved or new slot in the first free slot of its probe sequence
+    void place(const Slot& slot);
+    // Free the old array once nothing is left in it
+    void finishRehashIfDone();
+
+    SlotArray slots;            // The table; the new array during a resize
+    SlotArray old;              // Array being moved out of; empty otherwise
+    size_t migrated = 0;        // Slots of `old` already visited
+    size_t oldUsed = 0;         // Live entries still in `old`
+    size_t used = 0;            // Live entries in both arrays
+    size_t tombstones = 0;      // In `slots`
+    SlabAllocator* slab;        // Entries of this table; released, not deleted
+};
+
+#endif
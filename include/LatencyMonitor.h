@@ -0,0 +1,78 @@
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// Samples kept per event: one per second at most, so the last few minutes
+static const size_t LATENCY_HISTORY_LEN = 160;
+
+// Stalls over --latency-monitor-threshold milliseconds, grouped by named
+// event ("command", "expire-cycle", "snapshot-stall", ...), for LATENCY
+// LATEST and LATENCY HISTORY. Only samples over the threshold take the
+// lock, and with the threshold at 0 (the default) nothing is recorded.
+class LatencyMonitor {
+public:
+    static LatencyMonitor& getInstance();
+
+    struct Sample {
+        int64_t time = 0;   // Unix seconds
+        uint64_t ms = 0;
+    };
+    struct EventStats {
+        std::string name;
+        Sample latest;
+        uint64_t maxMs = 0; // Worst since startup or LATENCY RESET
+    };
+
+    // Record that `event` took `ms`, if that is over the threshold
+    void addSampleIfNeeded(std::string_view event, uint64_t ms);
+    std::vector<EventStats> latest() const;
+    // Samples of `event`, oldest first
+    std::vector<Sample> history(std::string_view event) const;
+    // Forget the given events, or all of them if none are given. Returns
+    // how many were forgotten.
+    size_t reset(const std::vector<std::string_view>& events);
+
+private:
+    LatencyMonitor();
+    ~LatencyMonitor() = default;
+    LatencyMonitor(const LatencyMonitor&) = delete;
+    LatencyMonitor& operator = (const LatencyMonitor&) = delete;
+
+    struct Series {
+        std::array<Sample, LATENCY_HISTORY_LEN> samples;   // Ring
+        size_t next = 0;
+        size_t count = 0;
+        uint64_t maxMs = 0;
+    };
+
+    uint64_t threshold;
+    mutable std::mutex mtx;     // Guards events
+    std::map<std::string, Series, std::less<>> events;
+};
+
+// Times the enclosing scope and records it as `event` on the way out
+class LatencyTimer {
+public:
+    explicit LatencyTimer(const char* event) : event(event), start(std::chrono::steady_clock::now()) {}
+    ~LatencyTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        LatencyMonitor::getInstance().addSampleIfNeeded(
+            event, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+    }
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator = (const LatencyTimer&) = delete;
+
+private:
+    const char* event;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef LAZY_FREE_H
+#define LAZY_FREE_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "Keyspace.h"
+
+// Values with more allocations than this are freed in the background;
+// smaller ones are cheaper to free on the spot than to hand over.
+static const size_t LAZYFREE_THRESHOLD = 64;
+
+// Roughly how many allocations freeing `entry` takes: one per quicklist
+// node or hash table field, one for anything held in a single block.
+size_t freeEffort(const KeyEntry& entry);
+
+// Background reclamation (UNLINK, FLUSHALL ASYNC). A command detaches what
+// it deletes from the keyspace, which is O(1), and queues it here; a
+// dedicated thread runs the destructors, so freeing a huge list or a whole
+// shard never holds a shard lock or delays the client.
+class LazyFree {
+public:
+    static LazyFree& getInstance();
+
+    // Free `entry` in the background if freeEffort() is over the threshold,
+    // otherwise right away
+    void freeEntry(KeyEntryPtr entry);
+    // Free a whole table detached by FLUSHALL ASYNC, along with `extra`
+    // (e.g. the shard's expiry heap), in the background
+    template <typename T>
+    void freeTable(std::unique_ptr<KeyspaceTable> table, T&& extra) {
+        size_t objects = table->size();
+        enqueue(std::make_unique<Garbage<std::pair<std::unique_ptr<KeyspaceTable>, std::decay_t<T>>>>(
+                    std::make_pair(std::move(table), std::forward<T>(extra))),
+                objects);
+    }
+
+    // Keys waiting to be freed
+    uint64_t pendingObjects() const { return pending; }
+    // Keys freed by the background thread so far
+    uint64_t freedObjects() const { return freed; }
+
+private:
+    LazyFree();
+    ~LazyFree();
+    LazyFree(const LazyFree&) = delete;
+    LazyFree& operator = (const LazyFree&) = delete;
+
+    // Anything queued for destruction; deleting it runs the destructors
+    struct Job {
+        virtual ~Job() = default;
+        size_t objects = 0;
+    };
+    template <typename T>
+    struct Garbage : Job {
+        explicit Garbage(T&& v) : value(std::move(v)) {}
+        T value;
+    };
+
+    void enqueue(std::unique_ptr<Job> job, size_t objects);
+    void run();
+
+    std::mutex mtx;                 // Guards jobs and stopping
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<Job>> jobs;
+    bool stopping = false;
+    std::atomic<uint64_t> pending{0};
+    std::atomic<uint64_t> freed{0};
+    std::thread worker;
+};
+
+#endif
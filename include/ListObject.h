@@ -0,0 +1,63 @@
+#ifndef LIST_OBJECT_H
+#define LIST_OBJECT_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include "Listpack.h"
+#include "Quicklist.h"
+
+// A list value in one of two encodings. A small list is a single Listpack,
+// one allocation for the whole list; once it grows past
+// list-max-listpack-size bytes it is converted to a Quicklist, whose first
+// node is the old listpack.
+class ListObject {
+public:
+    enum class Encoding { Listpack, Quicklist };
+
+    Encoding encoding() const { return quick ? Encoding::Quicklist : Encoding::Listpack; }
+    size_t size() const { return quick ? quick->size() : packed.size(); }
+    bool empty() const { return size() == 0; }
+    // Separately allocated nodes (1 for a listpack)
+    size_t nodeCount() const { return quick ? quick->nodeCount() : 1; }
+
+    void pushFront(std::string_view value);
+    void pushBack(std::string_view value);
+    bool popFront(std::string& value);
+    bool popBack(std::string& value);
+
+    // Element at `index`, counting from the tail if negative
+    bool index(long index, std::string& value) const;
+    bool set(long index, std::string_view value);
+    // LREM semantics, see Quicklist::remove
+    size_t remove(long count, std::string_view value);
+
+    // Approximate bytes allocated for the list, this object included
+    size_t memoryUsage() const;
+
+    // The listpack while the list is in the small encoding, else nullptr
+    const Listpack* listpack() const { return quick ? nullptr : &packed; }
+    // Replace the contents with a listpack blob from a snapshot. Returns
+    // false if the blob is malformed.
+    bool loadListpack(std::string_view raw);
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        if (quick) {
+            quick->forEach(fn);
+            return;
+        }
+        for (size_t pos = packed.first(); pos != packed.end(); pos = packed.next(pos)) {
+            fn(packed.get(pos));
+        }
+    }
+
+private:
+    // Switch to the quicklist encoding if the listpack has outgrown its limit
+    void convertIfLarge();
+
+    Listpack packed;
+    std::unique_ptr<Quicklist> quick;
+};
+
+#endif
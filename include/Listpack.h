@@ -0,0 +1,66 @@
+#ifndef LISTPACK_H
+#define LISTPACK_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// A sequence of strings packed into one contiguous buffer. Each entry is
+//
+//     <length varint> <bytes> <backlen>
+//
+// where backlen is the size of the first two parts, written so it can be
+// decoded from its last byte backwards. That makes the buffer walkable in
+// both directions without any per-entry pointers: a 10-byte element costs
+// 12 bytes instead of a heap-allocated std::string.
+//
+// Entries are addressed by their byte offset; end() is one past the last.
+// Offsets are invalidated by any modification.
+class Listpack {
+public:
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    // Bytes used by the packed entries
+    size_t bytes() const { return buf.size(); }
+    // Bytes allocated for the buffer
+    size_t allocated() const { return buf.capacity(); }
+    // Bytes an entry holding `len` bytes of data takes up
+    static size_t entrySize(size_t len);
+
+    size_t first() const { return 0; }
+    size_t last() const { return count ? prev(buf.size()) : buf.size(); }
+    size_t end() const { return buf.size(); }
+    size_t next(size_t pos) const;
+    size_t prev(size_t pos) const;
+    std::string_view get(size_t pos) const;
+    // Offset of the entry at `index`, counting from the tail if negative
+    // (walks from whichever end is nearer). end() if out of range.
+    size_t seek(long index) const;
+
+    void pushFront(std::string_view value) { insert(0, value); }
+    void pushBack(std::string_view value) { insert(buf.size(), value); }
+    // Insert before the entry at `pos`; returns the new entry's offset
+    size_t insert(size_t pos, std::string_view value);
+    // Remove the entry at `pos`; returns the offset of the entry after it
+    size_t erase(size_t pos);
+    // Overwrite the entry at `pos`; returns the offset of the entry after it
+    size_t replace(size_t pos, std::string_view value);
+    // Remove up to `max` entries equal to `value`, scanning from the tail if
+    // `fromTail`. Returns how many were removed.
+    size_t removeMatching(std::string_view value, size_t max, bool fromTail);
+
+    // The packed entries as one blob, and the reverse: adopt a blob after
+    // checking that it walks cleanly. Used to save and load snapshots.
+    std::string_view data() const { return buf; }
+    bool assign(std::string_view raw);
+
+    void clear() { buf.clear(); count = 0; }
+    void shrinkToFit() { buf.shrink_to_fit(); }
+
+private:
+    std::string buf;
+    uint32_t count = 0;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef LZF_H
+#define LZF_H
+
+#include <string>
+#include <string_view>
+
+// LZF-style byte-oriented LZ77 compression, used for large values in
+// snapshots. The format is a series of
+//
+//     000LLLLL <L+1 literal bytes>
+//     LLLooooo oooooooo             back reference of L+2 bytes (L < 7)
+//     111ooooo LLLLLLLL oooooooo    back reference of L+9 bytes
+//
+// with offsets up to 8KB back into the output.
+
+// Append the compressed form of `input` to `out`. Returns false (leaving
+// `out` unchanged) if compression would not save at least a few bytes.
+bool lzfCompress(std::string_view input, std::string& out);
+
+// Decompress `input`, which must expand to exactly `rawLen` bytes, and
+// append it to `out`. Returns false on malformed input.
+bool lzfDecompress(std::string_view input, size_t rawLen, std::string& out);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Bytes currently allocated through operator new, as reported by the
+// allocator (malloc_usable_size), so it includes allocator rounding, plus
+// the slab chunks in use. This is what the maxmemory limit is checked
+// against. Each thread counts on its own, so allocating stays contention
+// free; this sums the threads' counts.
+size_t usedMemory();
+// Allocations made so far by the calling thread (a plain thread-local
+// counter, so it costs no contention); for per-operation measurements
+uint64_t threadAllocationCount();
+
+// Zero-filled block from calloc, counted like operator new. Large blocks
+// are fresh pages that are already zero, so nothing is written up front.
+// Release with freeZeroed().
+void* allocZeroed(size_t bytes);
+void freeZeroed(void* p);
+// PAGE_BYTES block aligned to its size, for the slab allocator's slabs.
+// Pages are cut from larger mappings and kept for reuse once freed, their
+// memory handed back to the kernel meanwhile. They are not counted in
+// usedMemory(): the slab allocator counts the chunks it hands out instead
+// (countMemory), so freeing one key lowers usedMemory() right away even
+// though its page stays allocated. Release with freePage().
+static const size_t PAGE_BYTES = 4096;
+void* allocPage();
+void freePage(void* p);
+// Add `bytes` (negative when freed) of memory handed out from pages to usedMemory()
+void countMemory(int64_t bytes);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef QUICKLIST_H
+#define QUICKLIST_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include "Listpack.h"
+
+// Large list value: a deque of Listpack nodes, each holding up to
+// list-max-listpack-size bytes of packed elements. Pushes and pops only
+// touch the first or last node, so both ends are O(1) regardless of the
+// list length; indexed access skips whole nodes by their element count and
+// then walks inside one node.
+class Quicklist {
+public:
+    Quicklist() = default;
+    // Start from an existing listpack, which becomes the only node
+    explicit Quicklist(Listpack&& first);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t nodeCount() const { return nodes.size(); }
+
+    void pushFront(std::string_view value);
+    void pushBack(std::string_view value);
+    bool popFront(std::string& value);
+    bool popBack(std::string& value);
+
+    // Element at `index`, counting from the tail if negative
+    bool index(long index, std::string& value) const;
+    bool set(long index, std::string_view value);
+    // LREM semantics: remove up to |count| elements equal to `value`, from
+    // the head if count > 0, from the tail if count < 0, all if 0.
+    size_t remove(long count, std::string_view value);
+
+    // Approximate bytes allocated for the nodes and their contents
+    size_t memoryUsage() const;
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& node : nodes) {
+            for (size_t pos = node.first(); pos != node.end(); pos = node.next(pos)) {
+                fn(node.get(pos));
+            }
+        }
+    }
+
+private:
+    // Node and in-node offset of the element at `index`; false if out of range
+    bool locate(long index, size_t& node, size_t& pos) const;
+    static bool hasRoom(const Listpack& node, std::string_view value);
+
+    std::deque<Listpack> nodes;
+    size_t count = 0;
+};
+
+#endif
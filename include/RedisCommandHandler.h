@@ -2,66 +2,117 @@
 #define REDIS_COMMAND_HANDLER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "RedisDatabase.h"
+#include "ReplyBuffer.h"
+
+struct RedisCommand;
 
 class RedisCommandHandler {
 public:
     RedisCommandHandler();
+    // Parse one RESP command from `command`, execute it and return the reply.
     std::string handleCommand(const std::string& command);
+    // Execute an already parsed command, appending its RESP reply to `reply`.
+    // `client` ("ip:port") identifies the caller in the slow log.
+    void executeCommand(const std::vector<std::string_view>& tokens, ReplyBuffer& reply,
+                        std::string_view client = {});
+
+    // Append only file offset just past the last write this handler logged;
+    // the event loop flushes up to it before sending the replies.
+    uint64_t aofOffset() const { return lastAofOffset; }
+    // Set while the append only file is replayed through this handler:
+    // the maxmemory limit is not enforced and expired keys are kept then
+    void setLoading(bool on) {
+        loading = on;
+        RedisDatabase::setLoading(on);
+    }
+
+private:
+    void runCommand(const RedisCommand* command, const std::vector<std::string_view>& tokens, ReplyBuffer& reply);
+
+    uint64_t lastAofOffset = 0;
+    bool loading = false;
 };
 
 // Common commands
 // Handles the PING command. Returns "+PONG".
-std::string handlePing(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handlePing(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the ECHO command. Returns the message sent by the client.
-std::string handleEcho(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleEcho(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the FLUSHALL command. Clears the database.
-std::string handleFlushAll(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleFlushAll(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+
+// Persistence
+// Handles the SAVE command. Writes a snapshot, blocking writers until done.
+void handleSave(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the BGSAVE command. Writes a snapshot from a forked child.
+void handleBgsave(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the BGREWRITEAOF command. Rewrites the append only file from a forked child.
+void handleBgrewriteaof(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the LASTSAVE command. Returns the Unix time of the last successful save.
+void handleLastsave(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 
 // Key/Value operations
 // Handles the SET command. Sets the value of a key.
-std::string handleSet(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleSet(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the GET command. Gets the value of a key.
-std::string handleGet(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleGet(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the KEYS command. Returns all keys in the database.
-std::string handleKeys(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleKeys(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the SCAN command. Iterates over the keys with a cursor (MATCH, COUNT).
+void handleScan(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the TYPE command. Returns the type of the value stored at key.
-std::string handleType(const std::vector<std::string>& tokens, RedisDatabase& db);
-// Handles the DEL/UNLINK command. Deletes a key.
-std::string handleDel(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleType(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the DEL command. Deletes one or more keys.
+void handleDel(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the UNLINK command. Deletes keys like DEL, but a large value is freed on the lazy-free thread.
+void handleUnlink(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the EXPIRE command. Sets a timeout on a key.
-std::string handleExpire(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleExpire(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the PEXPIREAT command. Sets an absolute expiry time in Unix milliseconds.
+void handlePexpireat(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the RENAME command. Renames a key.
-std::string handleRename(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleRename(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles MEMORY USAGE key. Returns the approximate bytes the key and its value use.
+void handleMemory(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles INFO [section ...]. Returns server statistics as "field:value" lines.
+void handleInfo(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles SLOWLOG GET [count] | LEN | RESET. Reports commands that ran over the slow log threshold.
+void handleSlowlog(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles LATENCY LATEST | HISTORY event | RESET [event ...]. Reports stalls over the monitor threshold.
+void handleLatency(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 
 // List operations
 // Handles the LLEN command. Returns the length of a list.
-std::string handleLlen(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleLlen(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the LPUSH command. Inserts values at the head of a list.
-std::string handleLpush(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleLpush(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the RPUSH command. Inserts values at the tail of a list.
-std::string handleRpush(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleRpush(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the LPOP command. Removes and returns the first element of a list.
-std::string handleLpop(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleLpop(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the RPOP command. Removes and returns the last element of a list.
-std::string handleRpop(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleRpop(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the LREM command. Removes elements from a list.
-std::string handleLrem(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleLrem(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the LINDEX command. Gets an element from a list by its index.
-std::string handleLindex(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleLindex(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 // Handles the LSET command. Sets the value of an element in a list by its index.
-std::string handleLset(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleLset(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 
 // Hash command handlers
-std::string handleHset(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHget(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHexists(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHdel(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHgetall(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHkeys(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHvals(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHlen(const std::vector<std::string>& tokens, RedisDatabase& db);
-std::string handleHmset(const std::vector<std::string>& tokens, RedisDatabase& db);
+void handleHset(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHget(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHexists(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHdel(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHgetall(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+// Handles the HSCAN command. Iterates over the fields and values of a hash with a cursor.
+void handleHscan(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHkeys(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHvals(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHlen(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
+void handleHmset(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply);
 
 #endif
\ No newline at end of file
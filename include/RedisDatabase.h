@@ -1,67 +1,293 @@
 #include <string>
+#include <string_view>
 #include <mutex>
+#include <shared_mutex>
+#include <array>
 #include <unordered_map>
 #include <vector>
-#include <chrono>
+#include <stdexcept>
+#include <atomic>
+#include <condition_variable>
+#include <sys/types.h>
+#include <functional>
+#include "Keyspace.h"
+#include "Eviction.h"
 
 #ifndef REDIS_DATABASE_H
 #define REDIS_DATABASE_H
 
+// Thrown when a command is used on a key holding another type of value
+class WrongTypeError : public std::runtime_error {
+public:
+    WrongTypeError() : std::runtime_error("WRONGTYPE Operation against a key holding the wrong kind of value") {}
+};
+
 class RedisDatabase {
 public:
     // Get the singleton instance
     static RedisDatabase& getInstance();
 
-    bool flushAll();
+    // Remove every key. With `async` the shards' tables are swapped for
+    // empty ones and freed by the lazy-free thread.
+    bool flushAll(bool async = false);
 
     // Key-Value operations
-    void set(const std::string& key, const std::string& value);
-    bool get(const std::string& key, std::string& value);
-    bool del(const std::string& key);
-    bool exists(const std::string& key);
-    std::vector<std::string> keys();
-    std::string type(const std::string& key);
-    bool expire(const std::string& key, int seconds);
-    bool rename(const std::string& oldKey, const std::string& newKey);
+    void set(std::string_view key, std::string_view value);
+    bool get(std::string_view key, std::string& value);
+    bool del(std::string_view key);
+    // Like del(), but a large value is freed by the lazy-free thread
+    bool unlink(std::string_view key);
+    bool exists(std::string_view key);
+    // Keys matching a glob pattern, from one consistent view of the keyspace
+    std::vector<std::string> keys(std::string_view pattern = "*");
+    // One step of a SCAN walk: appends about `count` keys matching
+    // `pattern` to `out` and returns the next cursor (0 when done). Start
+    // with cursor 0. Every key that exists for the whole walk is returned
+    // at least once, even across table resizes; a key may come up twice.
+    uint64_t scan(uint64_t cursor, size_t count, std::string_view pattern, std::vector<std::string>& out);
+    std::string type(std::string_view key);
+    bool expire(std::string_view key, int seconds);
+    // Expire at an absolute Unix time in milliseconds (what the AOF records)
+    bool expireAt(std::string_view key, int64_t unixMs);
+    // Set while the append only file is replayed: keys whose deadline has
+    // passed are kept, since later logged commands may still use them.
+    // Active or lazy expiry removes them once loading is over.
+    static void setLoading(bool on);
+    bool rename(std::string_view oldKey, std::string_view newKey);
 
     // List Operations
-    ssize_t llen(const std::string& key);
-    void lpush(const std::string& key, const std::vector<std::string>& values);
-    void rpush(const std::string& key, const std::vector<std::string>& values);
-    bool lpop(const std::string& key, std::string& value);
-    bool rpop(const std::string& key, std::string& value);
-    int lrem(const std::string& key, int count, const std::string& value);
-    bool lindex(const std::string& key, int index, std::string& value);
-    bool lset(const std::string& key, int index, const std::string& value);
+    ssize_t llen(std::string_view key);
+    // Push `count` values starting at `values` (e.g. a slice of the command
+    // arguments). Both return the length of the list after the push.
+    size_t lpush(std::string_view key, const std::string_view* values, size_t count);
+    size_t rpush(std::string_view key, const std::string_view* values, size_t count);
+    bool lpop(std::string_view key, std::string& value);
+    bool rpop(std::string_view key, std::string& value);
+    int lrem(std::string_view key, int count, std::string_view value);
+    bool lindex(std::string_view key, int index, std::string& value);
+    bool lset(std::string_view key, int index, std::string_view value);
 
     // Hash Operations
-    int hset(const std::string& key, const std::string& field, const std::string& value);
-    bool hget(const std::string& key, const std::string& field, std::string& value);
-    bool hexists(const std::string& key, const std::string& field);
-    int hdel(const std::string& key, const std::string& field);
-    std::unordered_map<std::string, std::string> hgetall(const std::string& key);
-    std::vector<std::string> hkeys(const std::string& key);
-    std::vector<std::string> hvals(const std::string& key);
-    int hlen(const std::string& key);
-    int hmset(const std::string& key, const std::vector<std::pair<std::string, std::string>>& field_values);
-
-    // Persistance: dump / load the database from a file
+    int hset(std::string_view key, std::string_view field, std::string_view value);
+    bool hget(std::string_view key, std::string_view field, std::string& value);
+    bool hexists(std::string_view key, std::string_view field);
+    int hdel(std::string_view key, std::string_view field);
+    std::vector<std::pair<std::string, std::string>> hgetall(std::string_view key);
+    // One step of an HSCAN walk over the hash at `key`, same contract as scan()
+    uint64_t hscan(std::string_view key, uint64_t cursor, size_t count, std::string_view pattern,
+                   std::vector<std::pair<std::string, std::string>>& out);
+    std::vector<std::string> hkeys(std::string_view key);
+    std::vector<std::string> hvals(std::string_view key);
+    int hlen(std::string_view key);
+    // `field_values` holds `count` arguments laid out as field, value, field, value, ...
+    int hmset(std::string_view key, const std::string_view* field_values, size_t count);
+
+    // Persistance: dump / load the database from a file. dump() blocks
+    // writers for the whole save and cancels a running background save.
     bool dump(const std::string& filename);
-    bool load(const std::string& filename); 
+    // load() maps the file and parses the snapshot's sections in parallel.
+    bool load(const std::string& filename);
+
+    // Keys loaded and time taken by the last load() (startup time)
+    struct LoadStatus {
+        uint64_t keys = 0;
+        int64_t durationMs = -1;
+    };
+    LoadStatus loadStatus() const;
+
+    // Save in a forked child working on a copy-on-write image of the
+    // keyspace; writers are only blocked for the fork itself. Returns false
+    // if a background save is already running or fork() fails.
+    bool backgroundSave(const std::string& filename);
+
+    // Write the whole keyspace as commands that recreate it, to seed an
+    // append-only file from the loaded snapshot (temp file, then rename).
+    bool writeAofImage(const std::string& filename);
+    // Fork a child that writes the same image to `filename` and exits with
+    // status 0 on success. Returns its pid, or -1 if fork() fails.
+    // `beforeFork` runs with every shard locked, so no change can slip in
+    // between it and the image.
+    pid_t forkAofImage(const std::string& filename, const std::function<void()>& beforeFork);
+
+    struct SaveStatus {
+        bool inProgress = false;
+        int64_t startedAtMs = 0;        // Unix ms; current background save
+        uint64_t keysSaved = 0;         // Progress of the current save...
+        uint64_t keysTotal = 0;         // ...out of at most this many keys (expired ones are skipped)
+        int64_t lastSaveAtMs = 0;       // Unix ms of the last successful save (or startup)
+        bool lastBgsaveOk = true;
+        int64_t lastBgsaveDurationMs = -1;
+    };
+    SaveStatus saveStatus() const;
+
+    // Active expiry: remove keys whose TTL has passed, even if nobody reads
+    // them again. Runs for at most `budgetMs` and returns the keys removed.
+    size_t activeExpireCycle(int64_t budgetMs);
+    // Keys removed because their TTL passed, lazily or by the active cycle
+    uint64_t expiredKeyCount() const;
+
+    // Active defrag: move keys out of sparse slabs so those slabs can be
+    // freed. A pass over the keyspace starts when the slab memory lost to
+    // holes crosses the --active-defrag-* thresholds; each call works on it
+    // for at most `budgetMs`. Returns the keys moved.
+    size_t activeDefragCycle(int64_t budgetMs);
+    bool activeDefragRunning() const { return defragRunning.load(std::memory_order_relaxed); }
+    // Keys moved by active defrag
+    uint64_t defragHitCount() const { return defragHits.load(std::memory_order_relaxed); }
+    // Slab memory of the keyspace entries, summed over the shards
+    SlabAllocator::Stats slabStats();
+
+    // Key counts for INFO keyspace, exact and summed shard by shard
+    struct KeyspaceStats {
+        uint64_t keys = 0;
+        uint64_t strings = 0;
+        uint64_t lists = 0;
+        uint64_t hashes = 0;
+        uint64_t volatileKeys = 0;      // Keys with a TTL
+    };
+    KeyspaceStats keyspaceStats();
+
+    // Evict keys under the maxmemory policy until memory use is back under
+    // maxmemory; evicted keys are propagated as DEL. Returns false if memory
+    // is still over the limit: the policy is noeviction or nothing
+    // evictable was found.
+    bool freeMemoryIfNeeded();
+    // Keys removed by eviction
+    uint64_t evictedKeyCount() const;
+    // Approximate bytes used by `key` and its value; -1 if it does not exist
+    long long memoryUsage(std::string_view key);
+
+    // While a Propagation is alive, each change the calling thread makes to
+    // the keyspace is fed to the append only file as a command replaying it
+    // (SET, DEL, PEXPIREAT with an absolute deadline, ...). The feed happens
+    // inside the shard locks covering the change, so writes to one shard
+    // reach the log in the order they reached the keyspace without any
+    // global lock; a command that changes nothing logs nothing. `offset` is
+    // set to the log offset past the last change fed.
+    class Propagation {
+    public:
+        explicit Propagation(uint64_t& offset);
+        ~Propagation();
+        Propagation(const Propagation&) = delete;
+        Propagation& operator = (const Propagation&) = delete;
+
+    private:
+        uint64_t* previous;
+    };
+
+    // Number of independently locked keyspace shards
+    static const size_t SHARD_COUNT = 64;
+    // The active expiry cycle runs every ACTIVE_EXPIRE_INTERVAL_MS and may
+    // use up to ACTIVE_EXPIRE_BUDGET_MS of each interval.
+    static const int ACTIVE_EXPIRE_INTERVAL_MS = 100;
+    static const int ACTIVE_EXPIRE_BUDGET_MS = 25;
+    // Likewise for a running active defrag pass
+    static const int ACTIVE_DEFRAG_INTERVAL_MS = 100;
+    static const int ACTIVE_DEFRAG_BUDGET_MS = 10;
+
 private:
-    RedisDatabase() = default;
+    RedisDatabase();
     ~RedisDatabase() = default;
     RedisDatabase(const RedisDatabase&) = delete;
     RedisDatabase& operator = (const RedisDatabase&) = delete;
 
-    void removeIfExpired(const std::string& key);
+    // Pending deadline in a shard's expiry heap. Items are not removed when
+    // a key is deleted or its TTL changes; an item whose deadline no longer
+    // matches the entry's expireAt is stale and dropped when it surfaces.
+    struct ExpireItem {
+        int64_t deadline;
+        uint64_t hash;
+        std::string key;
+        bool operator > (const ExpireItem& other) const { return deadline > other.deadline; }
+    };
+
+    // One slice of the keyspace. A key always lives in the shard picked by
+    // its hash, so single-key commands only lock that shard; reads share the
+    // lock and writes take it exclusively. Aligned so two shards' locks never
+    // share a cache line.
+    struct alignas(64) Shard {
+        std::shared_mutex mtx;
+        KeyspaceTable table; // Every key of the shard, whatever its type
+        std::vector<ExpireItem> expires; // Min-heap on deadline
+        std::atomic<uint64_t> expired{0}; // Keys removed for having expired
+        // Keys of each type and keys with a TTL, kept up to date by the
+        // helpers below; every change to the table's keys, their types or
+        // their TTLs goes through them
+        std::array<uint64_t, 3> typeCounts{};
+        uint64_t volatileKeys = 0;
+
+        // Entry for `key` if it exists and has not expired (any lock held)
+        KeyEntry* findLive(std::string_view key, uint64_t hash) const;
+        // Like findLive, but also frees an expired entry (exclusive lock held)
+        KeyEntry* findForWrite(std::string_view key, uint64_t hash);
+        // Record the TTL just set on `entry` in the expiry heap (exclusive lock held)
+        void scheduleExpiry(const KeyEntry& entry, uint64_t hash);
+        // Remove up to `max` keys whose deadline has passed (exclusive lock
+        // held). `more` is set if further keys are already due.
+        size_t expireDue(int64_t now, size_t max, bool& more);
+
+        // The helpers below keep the counts right (exclusive lock held).
+        // Add a key that is not in the table
+        KeyEntry* insert(std::string_view key, uint64_t hash, KeyValue&& value);
+        // Take a key out of the table; nullptr if it is not there
+        KeyEntryPtr remove(std::string_view key, uint64_t hash);
+        bool erase(std::string_view key, uint64_t hash) { return remove(key, hash) != nullptr; }
+        // Replace the value with one of any type
+        void setValue(KeyEntry& entry, KeyValue&& value);
+        // Set the deadline (0: none) and schedule it in the expiry heap
+        void setExpireAt(KeyEntry& entry, uint64_t hash, int64_t deadline);
+        void clear();
+        void count(const KeyEntry& entry, int delta);
+    };
+
+    // Write every shard as a binary snapshot to a temporary file, then
+    // rename it over `filename` (caller keeps the keyspace stable). The
+    // keys written are counted in `progress` if given, a shard at a time.
+    bool writeSnapshot(const std::string& filename, std::atomic<uint64_t>* progress = nullptr) const;
+    // Commands recreating every live key, written to `fd` (keyspace stable)
+    bool writeAofEntries(int fd) const;
+    // Wait for a background save child writing `filename` to exit, record
+    // how it went and remove its temporary file if it did not finish
+    void reapSaveChild(pid_t pid, const std::string& filename);
+    // Parse a binary snapshot (exclusive locks held)
+    bool loadSnapshot(std::string_view data, const std::string& filename);
+    // Parse the original text dump format (exclusive locks held)
+    bool loadText(const std::string& data);
+
+    // A key sampled for eviction; the pool keeps the best ones across rounds
+    struct EvictionCandidate {
+        uint64_t score;
+        uint64_t hash;
+        std::string key;
+    };
+    static const size_t EVICTION_POOL_SIZE = 16;
+    // Sample up to `samples` keys of `shard` (from a position derived from
+    // `start`) into the eviction pool (evictMtx held)
+    void sampleForEviction(Shard& shard, EvictionPolicy policy, size_t samples, uint64_t start);
+
+    static size_t shardIndex(uint64_t hash);
+    Shard& shardFor(uint64_t hash) { return shards[shardIndex(hash)]; }
+
+    std::array<Shard, SHARD_COUNT> shards;
+
+    // Background save state, guarded by saveMtx
+    mutable std::mutex saveMtx;
+    std::condition_variable saveDone;
+    pid_t saveChild = -1;
+    SaveStatus status;
+    LoadStatus loaded;
+    std::atomic<uint64_t>* saveProgress = nullptr;  // Shared memory the child updates
 
-    std::mutex mtx; // Mutex for thread safety
-    std::unordered_map<std::string, std::string> kv_store; // In-memory key-value store
-    std::unordered_map<std::string, std::vector<std::string>> list_store; // In-memory list store
-    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> hash_store; // In-memory hash store
+    // Eviction state, guarded by evictMtx
+    std::mutex evictMtx;
+    std::vector<EvictionCandidate> evictionPool;    // Ascending score
+    std::atomic<uint64_t> evicted{0};
 
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> expiry_map;
+    // Active defrag state; the position is only used by the defrag thread
+    size_t defragShard = 0;
+    size_t defragCursor = 0;
+    std::atomic<bool> defragRunning{false};
+    std::atomic<uint64_t> defragHits{0};
 };
 
 #endif
\ No newline at end of file
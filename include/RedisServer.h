@@ -3,18 +3,21 @@
 
 #include <string>
 #include <atomic>
+#include <vector>
 
 class RedisServer {
 public:
-    RedisServer(int port);
+    RedisServer(int port, int ioThreads = 1);
     void run();
     void shutdown();
     
 private:
     int port;
-    int server_fd;
+    int ioThreads;
+    std::vector<int> listen_fds; // One SO_REUSEPORT listener per reactor thread
     std::atomic<bool> running;
     void setupSignalHandler();
+    int createListener();
 };
 #endif
 
@@ -0,0 +1,58 @@
+#ifndef REPLY_BUFFER_H
+#define REPLY_BUFFER_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <cstddef>
+#include <sys/uio.h>
+
+// Per-connection output buffer with RESP reply builders that write straight
+// into it. Small replies are packed into contiguous chunks; a bulk value of
+// at least LARGE_VALUE bytes passed by rvalue is kept as its own chunk and
+// referenced by an iovec instead of being copied, so writev() sends it from
+// where the handler left it.
+class ReplyBuffer {
+public:
+    static const size_t CHUNK_SIZE = 16 * 1024;
+    static const size_t LARGE_VALUE = 16 * 1024;
+
+    void addSimpleString(std::string_view str);     // +str
+    void addError(std::string_view msg);            // -msg
+    void addInteger(long long value);               // :value
+    void addBulkString(std::string_view value);     // $len value
+    void addBulkString(std::string&& value);
+    void addNull();                                 // $-1
+    void addArrayHeader(size_t count);              // *count, followed by the elements
+    void addRaw(std::string_view bytes);
+
+    // Bytes not yet written to the socket
+    size_t pending() const { return total - headOffset; }
+    bool empty() const { return pending() == 0; }
+
+    // Point up to `max` iovecs at the unsent bytes. Returns how many were filled.
+    int fillIovec(struct iovec* iov, int max) const;
+    // Drop `bytes` bytes from the front after a successful write.
+    void consume(size_t bytes);
+
+    // Copy out everything pending (replay, tests and benchmarks).
+    std::string str() const;
+    void clear();
+
+    // Number of error replies added so far (lets a caller see whether a command failed)
+    size_t errorCount() const { return errors; }
+
+private:
+    struct Chunk {
+        std::string data;
+        bool sealed;    // Large value owned by the buffer; nothing is appended to it
+    };
+    std::string& tail(size_t need);
+
+    std::deque<Chunk> chunks;
+    size_t headOffset = 0;  // Bytes of chunks.front() already written
+    size_t total = 0;       // Bytes in all chunks, including written ones in the head
+    size_t errors = 0;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef RESP_PARSER_H
+#define RESP_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Incremental RESP request parser. It reads commands out of a connection's
+// input buffer and remembers how far it got, so a frame split across several
+// reads is resumed instead of re-parsed, and a pipelined batch yields one
+// command per call to next(). Tokens are views into the buffer: they stay
+// valid until the buffer is next modified.
+class RespParser {
+public:
+    // Limits on a single request, matching the ones Redis enforces
+    static const long long MAX_ARGS = 1024 * 1024;
+    static const long long MAX_BULK_LEN = 512LL * 1024 * 1024;
+    static const size_t MAX_INLINE_LEN = 64 * 1024;
+
+    enum class Status {
+        Command,    // A complete command was stored in `tokens`
+        NeedMore,   // The buffer ends in the middle of a frame
+        Error       // Malformed input; the connection should be dropped
+    };
+
+    // Parse the next command from `buf`, starting where the previous call
+    // stopped. Bytes of earlier commands stay in `buf` until compact().
+    Status next(const std::string& buf, std::vector<std::string_view>& tokens);
+
+    // Bytes at the front of the buffer that belong to finished commands.
+    size_t consumed() const { return frameStart; }
+
+    // Tell the parser the caller erased the first consumed() bytes.
+    void compact();
+
+    const std::string& error() const { return errorMsg; }
+
+private:
+    Status fail(const char* msg);
+    Status parseInline(const std::string& buf, std::vector<std::string_view>& tokens);
+    void reset();
+
+    size_t frameStart = 0;      // Offset of the frame being parsed
+    size_t pos = 0;             // Offset of the next unparsed byte
+    long long argsLeft = -1;    // Bulk strings still expected; -1 before the '*' header
+    long long bulkLen = -1;     // Length of the pending bulk string; -1 before its '$' header
+    std::vector<std::pair<size_t, size_t>> spans; // (offset, length) of parsed arguments
+    std::string errorMsg;
+};
+
+// Parse a single RESP (or inline) command from `command`. The returned
+// tokens point into `command`.
+std::vector<std::string_view> parseRespCommand(const std::string& command);
+
+// Parse a base-10 signed 64-bit integer that spans all of `str` (no sign
+// other than a leading '-', no spaces). Returns false on anything else,
+// including overflow.
+bool parseInteger(std::string_view str, long long& out);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <string>
+
+// Server settings, filled in from the command line at startup.
+// Usage: my_redis_server [port] [--option value ...]
+struct ServerConfig {
+    int port = 6379;    // Default port number for Redis
+    int ioThreads = 0;  // Number of reactor threads; 0 means one per core
+    size_t outputBufferLimit = 256ULL * 1024 * 1024; // A client with more unsent reply bytes is disconnected
+
+    // Small hashes and lists are kept as a packed listpack until they cross these limits
+    size_t hashMaxListpackEntries = 128;    // Fields
+    size_t hashMaxListpackValue = 64;       // Bytes in one field or value
+    size_t listMaxListpackSize = 8 * 1024;  // Bytes in one listpack (also the quicklist node size)
+
+    std::string dbFilename = "dump.my_rdb";   // Snapshot file, relative to the working directory
+    int saveInterval = 300;             // Seconds between periodic background saves; 0 disables them
+    bool snapshotCompression = true;    // LZF-compress large strings in snapshots
+
+    bool appendOnly = false;            // Log write commands to the append only file
+    std::string appendFilename = "appendonly.aof";
+    std::string appendFsync = "everysec";   // always, everysec or no
+    // Rewrite the append only file once it is this many percent larger than
+    // after the last rewrite (0 disables) and at least the minimum size
+    int autoAofRewritePercentage = 100;
+    size_t autoAofRewriteMinSize = 64ULL * 1024 * 1024;
+
+    size_t maxmemory = 0;               // Bytes; 0 means no limit
+    std::string maxmemoryPolicy = "noeviction"; // noeviction, allkeys-lru, volatile-lru, allkeys-lfu, volatile-ttl
+    size_t maxmemorySamples = 5;        // Keys sampled per eviction round
+    int lfuLogFactor = 10;              // Higher: the LFU counter saturates after more accesses
+    int lfuDecayTime = 1;               // Minutes per LFU counter decrement when idle; 0: never
+
+    long long slowlogLogSlowerThan = 10000; // Microseconds; commands taking longer go to the slow log, negative disables it
+    size_t slowlogMaxLen = 128;         // Slow log entries kept
+    size_t latencyMonitorThreshold = 0; // Milliseconds; stalls this long are recorded for LATENCY, 0 disables it
+
+    // Move keys out of sparse slabs once the slab memory lost to holes is
+    // over both the percentage and the byte count below
+    bool activeDefrag = false;
+    int activeDefragThresholdLower = 10;                // Percent of slab memory
+    size_t activeDefragIgnoreBytes = 100ULL * 1024 * 1024;
+
+    // Get the process-wide configuration
+    static ServerConfig& getInstance();
+
+    // Parse argv. Returns false (after printing the reason) on a bad option.
+    bool parseArgs(int argc, char* argv[]);
+};
+
+// Parse a byte count with an optional kb/mb/gb suffix ("64mb"). Returns false if malformed.
+bool parseMemorySize(const std::string& str, size_t& bytes);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Command latencies are counted in log-scale buckets: 4 per power of two
+// of nanoseconds, so a percentile read back is within about 20%.
+static const int LATENCY_SUB_BUCKET_BITS = 2;
+static const size_t LATENCY_BUCKETS = (64 - LATENCY_SUB_BUCKET_BITS + 1) << LATENCY_SUB_BUCKET_BITS;
+
+// Counter written by one thread only and read by any: a relaxed load and
+// store instead of an atomic read-modify-write, so counting costs the
+// same as a plain increment and never bounces a cache line.
+class StatCounter {
+public:
+    void add(uint64_t n = 1) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+struct CommandStats {
+    StatCounter calls;
+    StatCounter failedCalls;        // Replied with an error
+    StatCounter totalNs;
+    std::array<StatCounter, LATENCY_BUCKETS> latency;
+
+    void record(uint64_t ns, bool failed);
+};
+
+// Everything one thread counts. Each thread that runs commands or serves
+// clients gets its own block on first use; blocks are never freed, so the
+// counts of a thread that exited still add up.
+struct ThreadStats {
+    explicit ThreadStats(size_t commands) : commands(new CommandStats[commands]) {}
+
+    std::unique_ptr<CommandStats[]> commands;  // By commandId()
+    StatCounter keyspaceHits;
+    StatCounter keyspaceMisses;
+    StatCounter connectionsReceived;
+    StatCounter connectionsClosed;
+    StatCounter netInputBytes;
+    StatCounter netOutputBytes;
+};
+
+// Server statistics for INFO. Hot paths only touch their own thread's
+// block; readers merge all the blocks.
+class ServerStats {
+public:
+    static ServerStats& getInstance();
+
+    // The calling thread's counters
+    static ThreadStats& local() {
+        thread_local ThreadStats* stats = getInstance().registerThread();
+        return *stats;
+    }
+
+    // Sums over every thread
+    struct CommandTotals {
+        uint64_t calls = 0;
+        uint64_t failedCalls = 0;
+        uint64_t totalNs = 0;
+        std::array<uint64_t, LATENCY_BUCKETS> latency{};
+
+        // Latency (ns) that `percentile` percent of the calls did not exceed,
+        // rounded up to its bucket
+        uint64_t percentile(double percentile) const;
+    };
+    struct Totals {
+        std::vector<CommandTotals> commands;   // By commandId()
+        uint64_t commandsProcessed = 0;
+        uint64_t keyspaceHits = 0;
+        uint64_t keyspaceMisses = 0;
+        uint64_t connectionsReceived = 0;
+        uint64_t connectedClients = 0;
+        uint64_t netInputBytes = 0;
+        uint64_t netOutputBytes = 0;
+    };
+    Totals collect() const;
+
+    // Take a sample of the command count and memory use. Called every
+    // STATS_SAMPLE_INTERVAL_MS to derive the instantaneous rates.
+    void sample();
+    // Commands per second over the last STATS_SAMPLES samples
+    double instantaneousOpsPerSec() const;
+    // Highest memory use seen by sample()
+    size_t peakMemory() const;
+    int64_t uptimeMs() const;
+
+    static const int STATS_SAMPLE_INTERVAL_MS = 100;
+    static const size_t STATS_SAMPLES = 16;
+
+private:
+    ServerStats();
+    ~ServerStats() = default;
+    ServerStats(const ServerStats&) = delete;
+    ServerStats& operator = (const ServerStats&) = delete;
+
+    ThreadStats* registerThread();
+
+    int64_t startedAtMs;
+    mutable std::mutex mtx;     // Guards threads and the samples
+    std::vector<std::unique_ptr<ThreadStats>> threads;
+    std::array<std::pair<int64_t, uint64_t>, STATS_SAMPLES> samples{};  // (steady ms, commands)
+    size_t sampleCount = 0;
+    size_t peak = 0;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "Memory.h"
+
+// Objects up to SLAB_MAX_OBJECT bytes are served from slabs: pages from
+// allocPage(), aligned to their size, carved into equal chunks of one size
+// class (multiples of SLAB_CLASS_STEP). A chunk costs no per-allocation
+// header, and its slab is found by masking the address.
+static const size_t SLAB_SIZE = PAGE_BYTES;
+static const size_t SLAB_CLASS_STEP = 16;
+static const size_t SLAB_MAX_OBJECT = 256;
+static const size_t SLAB_CLASSES = SLAB_MAX_OBJECT / SLAB_CLASS_STEP;
+
+// Chunk size that a request for `bytes` (at most SLAB_MAX_OBJECT) gets
+inline size_t slabChunkSize(size_t bytes) {
+    return (bytes + SLAB_CLASS_STEP - 1) & ~(SLAB_CLASS_STEP - 1);
+}
+
+// Size-class allocator for the keyspace entries of one table. Allocation
+// happens under the owning shard's lock, but a chunk may be freed from any
+// thread (lazy free), so the allocator has its own mutex.
+//
+// Freeing leaves holes, and a slab is only returned once all its chunks
+// are free. Active defrag moves chunks out of sparse slabs: shouldMove()
+// picks such a slab, takes it out of allocation, and the caller copies the
+// object into a chunk allocated elsewhere.
+class SlabAllocator {
+public:
+    SlabAllocator() = default;
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator = (const SlabAllocator&) = delete;
+
+    void* allocate(size_t bytes);
+    // Free a chunk from any allocator
+    static void deallocate(void* p);
+    // The owner is done with the allocator; it is deleted once the last
+    // chunk (possibly still queued for lazy free) is freed
+    void release();
+
+    // Whether the chunk at `p` should be moved for defragmentation. True
+    // for chunks of a slab under half full whose class has room for them
+    // in other slabs; that slab gets no new allocations from then on.
+    bool shouldMove(void* p);
+
+    struct Stats {
+        uint64_t slabs = 0;
+        uint64_t allocatedBytes = 0;    // Whole slabs
+        uint64_t usedBytes = 0;         // Chunks in use
+    };
+    Stats stats() const;
+
+private:
+    ~SlabAllocator();
+
+    struct Slab {
+        SlabAllocator* owner;
+        Slab* prev;             // In the class's partial list
+        Slab* next;
+        void* freeList;         // Freed chunks, linked through their first word
+        uint32_t chunkSize;
+        uint32_t capacity;      // Chunks
+        uint32_t used;
+        uint32_t carved;        // Chunks handed out from the untouched end so far
+        uint8_t cls;
+        bool listed;            // In the partial list
+        bool draining;          // Being emptied by defrag; never allocated from
+    };
+    static Slab* slabOf(void* p) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(SLAB_SIZE) - 1));
+    }
+    static size_t firstChunkOffset() { return slabChunkSize(sizeof(Slab)); }
+
+    Slab* newSlab(size_t cls);
+    void freeSlab(Slab* slab);
+    void link(Slab* slab);
+    void unlink(Slab* slab);
+    // Free a chunk (mtx held). Returns true if the allocator is to be deleted.
+    bool free(Slab* slab, void* p);
+
+    mutable std::mutex mtx;
+    // Slabs with free chunks (and not draining), by class; allocation takes the head
+    std::array<Slab*, SLAB_CLASSES> partial{};
+    std::array<uint64_t, SLAB_CLASSES> slabCount{};
+    std::array<uint64_t, SLAB_CLASSES> freeChunks{};    // Allocatable: in slabs not draining
+    uint64_t liveChunks = 0;
+    bool released = false;
+    // Read by stats() without the lock
+    std::atomic<uint64_t> totalSlabs{0};
+    std::atomic<uint64_t> usedBytes{0};
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef SLOW_LOG_H
+#define SLOW_LOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+// At most this many arguments, each cut to this many bytes, are kept per entry
+static const size_t SLOWLOG_MAX_ARGS = 32;
+static const size_t SLOWLOG_MAX_ARG_LEN = 128;
+
+struct SlowLogEntry {
+    uint64_t id = 0;                // Increases by one per logged command
+    int64_t time = 0;               // Unix seconds when the command finished
+    uint64_t durationUs = 0;
+    std::vector<std::string> args;  // Truncated, see above
+    std::string client;             // "ip:port", empty for internal callers
+};
+
+// Commands that ran longer than --slowlog-log-slower-than, for SLOWLOG GET.
+// A fixed ring of --slowlog-max-len slots: a writer takes the next id with
+// one fetch_add and fills slot id % capacity, swapping a prepared entry in
+// under the slot's flag. If a reader is copying that slot the entry is
+// dropped rather than waited for, so recording never blocks a reactor.
+class SlowLog {
+public:
+    static SlowLog& getInstance();
+
+    void record(const std::vector<std::string_view>& tokens, uint64_t durationUs, std::string_view client);
+    // Up to `count` entries, newest first
+    std::vector<SlowLogEntry> get(size_t count) const;
+    size_t length() const;
+    void reset();
+    // Entries lost to a slot being read at the time
+    uint64_t dropped() const { return droppedEntries.load(std::memory_order_relaxed); }
+
+private:
+    SlowLog();
+    ~SlowLog() = default;
+    SlowLog(const SlowLog&) = delete;
+    SlowLog& operator = (const SlowLog&) = delete;
+
+    struct Slot {
+        std::atomic<bool> busy{false};
+        bool used = false;
+        SlowLogEntry entry;
+    };
+    // Visit the live entries, each under its slot's flag
+    template <typename F>
+    void forEachEntry(F&& f) const;
+
+    size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> nextId{0};
+    std::atomic<uint64_t> firstId{0};      // Entries below this id were reset
+    std::atomic<uint64_t> droppedEntries{0};
+};
+
+#endif
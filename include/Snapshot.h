@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "Keyspace.h"
+
+// Binary snapshot format. All fixed-width integers are little-endian.
+//
+//   header   "MYRDB" u32 version, u32 section count, i64 save time (Unix ms),
+//            u32 CRC-32 of the header bytes before it
+//   section  u32 entry count, u64 payload bytes, u32 CRC-32 of the payload,
+//            payload (the entries)
+//   entry    u8 type, [i64 expiry (Unix ms) if type has SNAPSHOT_EXPIRES],
+//            string key, value
+//
+// A string is varint(length << 1 | compressed) followed by the bytes; a
+// compressed string adds varint(raw length) before its LZF data. A string
+// value is one string; a list is varint(count) strings; a hash is
+// varint(field count) field/value strings; the listpack types hold the
+// small encoding's blob as one string. Sections are self-contained, so a
+// loader can checksum and parse them independently.
+
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+enum SnapshotType : uint8_t {
+    SNAPSHOT_STRING = 0,
+    SNAPSHOT_LIST = 1,
+    SNAPSHOT_HASH = 2,
+    SNAPSHOT_LIST_LISTPACK = 3,
+    SNAPSHOT_HASH_LISTPACK = 4,
+    SNAPSHOT_EXPIRES = 0x80,
+};
+
+struct SnapshotHeader {
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t sections = 0;
+    int64_t savedAtMs = 0;
+};
+
+// A section located in the file; its checksum is verified separately so
+// sections can be checked and parsed in parallel.
+struct SnapshotSection {
+    uint32_t entries = 0;
+    uint32_t crc = 0;
+    std::string_view payload;
+};
+
+// One decoded entry. `key` points into the section payload.
+struct SnapshotEntry {
+    std::string_view key;
+    int64_t expireAtMs = 0;     // Unix ms; 0 means no TTL
+    KeyValue value;
+};
+
+// Writing
+void encodeSnapshotHeader(std::string& out, const SnapshotHeader& header);
+// Append `entry` to a section payload. `expireAtMs` is the entry's deadline
+// converted to Unix ms (0 for none).
+void encodeSnapshotEntry(std::string& payload, const KeyEntry& entry, int64_t expireAtMs, bool compress);
+void encodeSnapshotSectionHeader(std::string& out, uint32_t entries, std::string_view payload);
+
+// Reading. Each returns false if the data is truncated, corrupt or of an
+// unknown version; `offset` is advanced past what was consumed.
+bool isSnapshot(std::string_view data);
+bool decodeSnapshotHeader(std::string_view data, size_t& offset, SnapshotHeader& header);
+// Locate the next section (bounds only, no checksum)
+bool decodeSnapshotSection(std::string_view data, size_t& offset, SnapshotSection& section);
+bool verifySnapshotSection(const SnapshotSection& section);
+bool decodeSnapshotEntry(std::string_view payload, size_t& offset, SnapshotEntry& entry);
+
+#endif
@@ -0,0 +1,380 @@
+#include "../include/AppendOnlyFile.h"
+#include "../include/RedisCommandHandler.h"
+#include "../include/RespParser.h"
+#include "../include/ReplyBuffer.h"
+#include "../include/RedisDatabase.h"
+#include "../include/ServerConfig.h"
+#include "../include/LatencyMonitor.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <csignal>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Largest number of list items or hash fields per command when writing out
+// a whole key, so replaying a huge collection does not need one giant frame
+static const size_t ITEMS_PER_COMMAND = 64;
+// Rewrite buffer left to copy with writers stopped when a rewrite is installed
+static const size_t REWRITE_FINAL_CHUNK = 64 * 1024;
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+AppendOnlyFile& AppendOnlyFile::getInstance() {
+    static AppendOnlyFile instance;
+    return instance;
+}
+
+void encodeAofCommand(std::string& out, const std::string_view* args, size_t count) {
+    out += '*';
+    out += std::to_string(count);
+    out += "\r\n";
+    for (size_t i = 0; i < count; i++) {
+        out += '$';
+        out += std::to_string(args[i].size());
+        out += "\r\n";
+        out.append(args[i].data(), args[i].size());
+        out += "\r\n";
+    }
+}
+
+void encodeAofEntry(std::string& out, const KeyEntry& entry, int64_t expireAtMs) {
+    std::vector<std::string_view> args;
+    auto emit = [&]() {
+        encodeAofCommand(out, args.data(), args.size());
+        args.resize(2);
+    };
+
+    switch (entry.type()) {
+        case ObjectType::String:
+            args = {"SET", entry.key(), entry.str()};
+            emit();
+            break;
+        case ObjectType::List:
+            args = {"RPUSH", entry.key()};
+            entry.list().forEach([&](std::string_view item) {
+                args.push_back(item);
+                if (args.size() == 2 + ITEMS_PER_COMMAND) emit();
+            });
+            if (args.size() > 2) emit();
+            break;
+        case ObjectType::Hash:
+            args = {"HSET", entry.key()};
+            entry.hash().forEach([&](std::string_view field, std::string_view value) {
+                args.push_back(field);
+                args.push_back(value);
+                if (args.size() == 2 + 2 * ITEMS_PER_COMMAND) emit();
+            });
+            if (args.size() > 2) emit();
+            break;
+    }
+
+    if (expireAtMs) {
+        std::string when = std::to_string(expireAtMs);
+        args = {"PEXPIREAT", entry.key(), when};
+        encodeAofCommand(out, args.data(), args.size());
+    }
+}
+
+bool AppendOnlyFile::open(const std::string& name, FsyncPolicy fsyncPolicy) {
+    int f = ::open(name.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (f < 0) {
+        std::cerr << "Error opening append only file " << name << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st;
+    fileSize = baseSize = fstat(f, &st) == 0 ? st.st_size : 0;
+    filename = name;
+    policy = fsyncPolicy;
+    fd = f;
+    if (policy != FsyncPolicy::No) fsyncThread = std::thread(&AppendOnlyFile::fsyncLoop, this);
+    return true;
+}
+
+void AppendOnlyFile::close() {
+    if (fd < 0) return;
+    {
+        // A rewrite finishing now would install its file after we close
+        std::lock_guard<std::mutex> lock(rewriteMtx);
+        if (rewriteChild != -1) kill(rewriteChild, SIGKILL);
+    }
+    flush(0);
+    {
+        std::lock_guard<std::mutex> lock(syncMtx);
+        stopping = true;
+        syncCond.notify_all();
+    }
+    if (fsyncThread.joinable()) fsyncThread.join();
+    std::lock_guard<std::mutex> write(writeMtx);
+    fsync(fd);
+    ::close(fd);
+    fd = -1;
+}
+
+uint64_t AppendOnlyFile::feed(const std::string_view* args, size_t count) {
+    std::lock_guard<std::mutex> lock(queueMtx);
+    size_t before = queue.size();
+    encodeAofCommand(queue, args, count);
+    queued += queue.size() - before;
+    if (rewriting) rewriteBuf.append(queue, before, std::string::npos);
+    return queued;
+}
+
+bool AppendOnlyFile::writeData(const std::string& data) {
+    if (!writeAll(fd, data)) {
+        std::cerr << "Error writing append only file: " << strerror(errno) << "\n";
+        return false;
+    }
+    if (!data.empty()) {
+        fileSize += data.size();
+        std::lock_guard<std::mutex> lock(syncMtx);
+        written += data.size();
+        syncCond.notify_all();
+    }
+    return true;
+}
+
+bool AppendOnlyFile::flush(uint64_t offset) {
+    {
+        std::lock_guard<std::mutex> write(writeMtx);
+        if (fd < 0) return true;
+        std::string data;
+        {
+            std::lock_guard<std::mutex> lock(queueMtx);
+            data.swap(queue);
+        }
+        if (!writeData(data)) return false;
+    }
+
+    if (policy == FsyncPolicy::Always) {
+        std::unique_lock<std::mutex> lock(syncMtx);
+        syncCond.wait(lock, [&] { return synced >= offset || stopping; });
+    }
+    return true;
+}
+
+void AppendOnlyFile::fsyncLoop() {
+    std::unique_lock<std::mutex> lock(syncMtx);
+    while (!stopping) {
+        if (policy == FsyncPolicy::Always)
+            syncCond.wait(lock, [&] { return stopping || written > synced; });
+        else
+            syncCond.wait_for(lock, std::chrono::seconds(1), [&] { return stopping; });
+
+        uint64_t target = written;
+        if (target <= synced) continue;
+        // Everything written so far goes to disk in one fdatasync; writers
+        // arriving meanwhile are picked up by the next round. A rewrite
+        // waits for `syncing` to clear before closing the old file.
+        int f = fd;
+        syncing = true;
+        lock.unlock();
+        {
+            LatencyTimer stall("aof-fsync");
+            if (fdatasync(f) != 0) std::cerr << "Error syncing append only file: " << strerror(errno) << "\n";
+        }
+        lock.lock();
+        syncing = false;
+        if (target > synced) synced = target;
+        syncCond.notify_all();
+    }
+}
+
+bool AppendOnlyFile::backgroundRewrite() {
+    std::lock_guard<std::mutex> guard(rewriteMtx);
+    if (fd < 0 || rewriteChild != -1) return false;
+
+    std::string tmpname = filename + ".rewrite";
+    pid_t pid;
+    // Changes are fed from inside their shard locks, and the fork happens
+    // with every shard locked: everything fed before is in the child's
+    // image, everything after goes to the rewrite buffer.
+    pid = RedisDatabase::getInstance().forkAofImage(tmpname, [this]() {
+        std::lock_guard<std::mutex> lock(queueMtx);
+        rewriting = true;
+        rewriteBuf.clear();
+    });
+    if (pid < 0) {
+        std::lock_guard<std::mutex> lock(queueMtx);
+        rewriting = false;
+        std::string().swap(rewriteBuf);
+        lastRewriteOk = false;
+        return false;
+    }
+    std::cout << "Background append only file rewriting started by pid " << pid << "\n";
+    rewriteChild = pid;
+    std::thread(&AppendOnlyFile::finishRewrite, this, pid, tmpname, unixNowMs()).detach();
+    return true;
+}
+
+void AppendOnlyFile::finishRewrite(pid_t pid, std::string tmpname, int64_t startedAtMs) {
+    int wstatus = 0;
+    while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {}
+    bool ok = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0 && installRewrite(tmpname);
+    if (!ok) {
+        unlink(tmpname.c_str());
+        std::lock_guard<std::mutex> lock(queueMtx);
+        rewriting = false;
+        std::string().swap(rewriteBuf);
+    }
+
+    std::lock_guard<std::mutex> lock(rewriteMtx);
+    rewriteChild = -1;
+    lastRewriteOk = ok;
+    lastRewriteDurationMs = unixNowMs() - startedAtMs;
+    if (ok)
+        std::cout << "Append only file rewritten in " << lastRewriteDurationMs << " ms\n";
+    else
+        std::cerr << "Background append only file rewrite failed\n";
+}
+
+bool AppendOnlyFile::installRewrite(const std::string& tmpname) {
+    int newFd = ::open(tmpname.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (newFd < 0) return false;
+
+    // Catch up with the commands buffered while the child ran. Writers keep
+    // going meanwhile; only the last small remainder is copied with them
+    // stopped. The sync in between keeps the final fdatasync short.
+    std::string chunk;
+    auto drain = [&](size_t leave) {
+        while (true) {
+            chunk.clear();
+            {
+                std::lock_guard<std::mutex> lock(queueMtx);
+                if (rewriteBuf.size() <= leave) return true;
+                chunk.swap(rewriteBuf);
+            }
+            if (!writeAll(newFd, chunk)) return false;
+        }
+    };
+    if (!drain(REWRITE_FINAL_CHUNK) || fdatasync(newFd) != 0 || !drain(REWRITE_FINAL_CHUNK)) {
+        ::close(newFd);
+        return false;
+    }
+
+    int oldFd;
+    {
+        LatencyTimer stall("aof-rewrite-stall");
+        std::lock_guard<std::mutex> write(writeMtx);
+        std::lock_guard<std::mutex> lock(queueMtx);
+        if (fd < 0) {
+            ::close(newFd);
+            return false;
+        }
+        // Whatever is still queued goes to the old file as usual; the part
+        // of it fed after the fork is also in the rewrite buffer.
+        std::string data;
+        data.swap(queue);
+        bool ok = writeData(data) && writeAll(newFd, rewriteBuf) && fdatasync(newFd) == 0 &&
+                  ::rename(tmpname.c_str(), filename.c_str()) == 0;
+        if (!ok) {
+            std::cerr << "Error installing rewritten append only file: " << strerror(errno) << "\n";
+            ::close(newFd);
+            return false;
+        }
+        rewriting = false;
+        std::string().swap(rewriteBuf);
+
+        struct stat st;
+        fileSize = baseSize = fstat(newFd, &st) == 0 ? st.st_size : 0;
+        std::unique_lock<std::mutex> sync(syncMtx);
+        syncCond.wait(sync, [&] { return !syncing; });
+        oldFd = fd;
+        fd = newFd;
+        // The new file was synced above, so everything written so far is on disk
+        synced = written;
+        syncCond.notify_all();
+    }
+    ::close(oldFd);
+    return true;
+}
+
+void AppendOnlyFile::rewriteIfGrown() {
+    const ServerConfig& config = ServerConfig::getInstance();
+    if (fd < 0 || config.autoAofRewritePercentage <= 0) return;
+    uint64_t size = fileSize, base = baseSize;
+    if (size < config.autoAofRewriteMinSize) return;
+    if (size * 100 < base * (100 + config.autoAofRewritePercentage)) return;
+    {
+        std::lock_guard<std::mutex> lock(rewriteMtx);
+        if (rewriteChild != -1) return;
+    }
+    std::cout << "Append only file grew to " << size << " bytes (" << base << " after the last rewrite); rewriting\n";
+    backgroundRewrite();
+}
+
+AppendOnlyFile::RewriteStatus AppendOnlyFile::rewriteStatus() const {
+    std::lock_guard<std::mutex> lock(rewriteMtx);
+    RewriteStatus status;
+    status.inProgress = rewriteChild != -1;
+    status.lastOk = lastRewriteOk;
+    status.lastDurationMs = lastRewriteDurationMs;
+    status.size = fileSize;
+    status.baseSize = baseSize;
+    return status;
+}
+
+bool AppendOnlyFile::load(const std::string& filename, RedisCommandHandler& handler) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) return false;
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    RespParser parser;
+    std::vector<std::string_view> args;
+    ReplyBuffer reply;
+    size_t commands = 0;
+    handler.setLoading(true);
+    while (true) {
+        size_t offset = parser.consumed();
+        RespParser::Status status = parser.next(data, args);
+        if (status == RespParser::Status::Command) {
+            // Only successful writes are logged, so an error means the file
+            // does not describe the data it was written for
+            handler.executeCommand(args, reply);
+            if (reply.errorCount() > 0) {
+                std::cerr << "Command " << commands + 1 << " in " << filename << " at byte " << offset
+                          << " failed on replay: " << reply.str();
+                handler.setLoading(false);
+                return false;
+            }
+            reply.clear();
+            commands++;
+            continue;
+        }
+        if (status == RespParser::Status::Error) {
+            std::cerr << "Bad command in " << filename << " at byte " << parser.consumed()
+                      << ": " << parser.error() << "\n";
+            handler.setLoading(false);
+            return false;
+        }
+        break;
+    }
+    handler.setLoading(false);
+
+    if (parser.consumed() < data.size()) {
+        std::cerr << "Append only file " << filename << " ends with an incomplete command; truncating "
+                  << data.size() - parser.consumed() << " bytes\n";
+        if (truncate(filename.c_str(), parser.consumed()) != 0) {
+            std::cerr << "Error truncating " << filename << ": " << strerror(errno) << "\n";
+            return false;
+        }
+    }
+    std::cout << "Replayed " << commands << " commands from " << filename << "\n";
+    return true;
+}
@@ -0,0 +1,127 @@
+#include "../include/CommandTable.h"
+#include "../include/RedisCommandHandler.h"
+#include <array>
+
+// name, handler, arity, flags, first key, last key, key step
+static constexpr RedisCommand commandTable[] = {
+    // Common commands
+    {"ping",     handlePing,     -1, CMD_FAST,               0, 0, 0},
+    {"echo",     handleEcho,      2, CMD_FAST,               0, 0, 0},
+    {"flushall", handleFlushAll, -1, CMD_WRITE,              0, 0, 0},
+    {"info",     handleInfo,     -1, CMD_READONLY,           0, 0, 0},
+    {"slowlog",  handleSlowlog,  -2, 0,                      0, 0, 0},
+    {"latency",  handleLatency,  -2, 0,                      0, 0, 0},
+
+    // Persistence
+    {"save",     handleSave,      1, 0,                      0, 0, 0},
+    {"bgsave",   handleBgsave,   -1, 0,                      0, 0, 0},
+    {"lastsave", handleLastsave,  1, CMD_FAST,               0, 0, 0},
+    {"bgrewriteaof", handleBgrewriteaof, 1, 0,               0, 0, 0},
+
+    // Key/Value operations
+    {"set",      handleSet,      -3, CMD_WRITE | CMD_DENYOOM, 1, 1, 1},
+    {"get",      handleGet,       2, CMD_READONLY | CMD_FAST, 1, 1, 1},
+    {"keys",     handleKeys,     -1, CMD_READONLY,           0, 0, 0},
+    {"scan",     handleScan,     -2, CMD_READONLY,           0, 0, 0},
+    {"type",     handleType,      2, CMD_READONLY | CMD_FAST, 1, 1, 1},
+    {"del",      handleDel,      -2, CMD_WRITE,              1, -1, 1},
+    {"unlink",   handleUnlink,   -2, CMD_WRITE | CMD_FAST,   1, -1, 1},
+    {"expire",   handleExpire,    3, CMD_WRITE | CMD_FAST,   1, 1, 1},
+    {"pexpireat", handlePexpireat, 3, CMD_WRITE | CMD_FAST,  1, 1, 1},
+    {"rename",   handleRename,    3, CMD_WRITE,              1, 2, 1},
+    {"memory",   handleMemory,   -2, CMD_READONLY,           2, 2, 1},
+
+    // List operations
+    {"llen",     handleLlen,      2, CMD_READONLY | CMD_FAST, 1, 1, 1},
+    {"lpush",    handleLpush,    -3, CMD_WRITE | CMD_FAST | CMD_DENYOOM, 1, 1, 1},
+    {"rpush",    handleRpush,    -3, CMD_WRITE | CMD_FAST | CMD_DENYOOM, 1, 1, 1},
+    {"lpop",     handleLpop,      2, CMD_WRITE | CMD_FAST,   1, 1, 1},
+    {"rpop",     handleRpop,      2, CMD_WRITE | CMD_FAST,   1, 1, 1},
+    {"lrem",     handleLrem,      4, CMD_WRITE,              1, 1, 1},
+    {"lindex",   handleLindex,    3, CMD_READONLY,           1, 1, 1},
+    {"lset",     handleLset,      4, CMD_WRITE | CMD_DENYOOM, 1, 1, 1},
+
+    // Hash operations
+    {"hset",     handleHset,     -4, CMD_WRITE | CMD_FAST | CMD_DENYOOM, 1, 1, 1},
+    {"hget",     handleHget,      3, CMD_READONLY | CMD_FAST, 1, 1, 1},
+    {"hexists",  handleHexists,   3, CMD_READONLY | CMD_FAST, 1, 1, 1},
+    {"hdel",     handleHdel,     -3, CMD_WRITE | CMD_FAST,   1, 1, 1},
+    {"hgetall",  handleHgetall,   2, CMD_READONLY,           1, 1, 1},
+    {"hscan",    handleHscan,    -3, CMD_READONLY,           1, 1, 1},
+    {"hkeys",    handleHkeys,     2, CMD_READONLY,           1, 1, 1},
+    {"hvals",    handleHvals,     2, CMD_READONLY,           1, 1, 1},
+    {"hlen",     handleHlen,      2, CMD_READONLY | CMD_FAST, 1, 1, 1},
+    {"hmset",    handleHmset,    -4, CMD_WRITE | CMD_FAST | CMD_DENYOOM, 1, 1, 1},
+};
+
+static constexpr size_t COMMAND_COUNT = sizeof(commandTable) / sizeof(commandTable[0]);
+
+// Open-addressing index from name hash to table position, built at compile
+// time. Keeping it at most half full means a lookup is one hash of the name
+// and usually a single slot probe.
+static constexpr size_t INDEX_SLOTS = 128;
+static_assert(COMMAND_COUNT * 2 <= INDEX_SLOTS, "grow INDEX_SLOTS with the command table");
+
+static constexpr char toLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a over the lower-cased name
+static constexpr uint32_t hashName(const char* name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<uint8_t>(toLower(name[i]));
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static constexpr size_t nameLength(const char* name) {
+    size_t len = 0;
+    while (name[len]) len++;
+    return len;
+}
+
+static constexpr std::array<int16_t, INDEX_SLOTS> buildIndex() {
+    std::array<int16_t, INDEX_SLOTS> index {};
+    for (auto& slot : index) slot = -1;
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        const char* name = commandTable[i].name;
+        size_t slot = hashName(name, nameLength(name)) & (INDEX_SLOTS - 1);
+        while (index[slot] != -1) slot = (slot + 1) & (INDEX_SLOTS - 1);
+        index[slot] = static_cast<int16_t>(i);
+    }
+    return index;
+}
+
+static constexpr std::array<int16_t, INDEX_SLOTS> commandIndex = buildIndex();
+
+// `name` is lower case; `input` may be any case.
+static bool equalsIgnoreCase(const char* name, std::string_view input) {
+    for (size_t i = 0; i < input.size(); i++) {
+        if (name[i] == '\0' || name[i] != toLower(input[i])) return false;
+    }
+    return name[input.size()] == '\0';
+}
+
+const RedisCommand* lookupCommand(std::string_view name) {
+    size_t slot = hashName(name.data(), name.size()) & (INDEX_SLOTS - 1);
+    while (commandIndex[slot] != -1) {
+        const RedisCommand& command = commandTable[commandIndex[slot]];
+        if (equalsIgnoreCase(command.name, name)) return &command;
+        slot = (slot + 1) & (INDEX_SLOTS - 1);
+    }
+    return nullptr;
+}
+
+size_t commandCount() {
+    return COMMAND_COUNT;
+}
+
+size_t commandId(const RedisCommand* command) {
+    return static_cast<size_t>(command - commandTable);
+}
+
+const RedisCommand& commandById(size_t id) {
+    return commandTable[id];
+}
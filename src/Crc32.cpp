@@ -0,0 +1,37 @@
+#include "../include/Crc32.h"
+#include <array>
+
+// Slicing-by-8 tables: table[0] is the classic byte-at-a-time table, and
+// table[k][b] is the CRC of byte b followed by k zero bytes, so eight input
+// bytes are folded in with eight independent lookups.
+static std::array<std::array<uint32_t, 256>, 8> buildTables() {
+    std::array<std::array<uint32_t, 256>, 8> table {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+        }
+    }
+    return table;
+}
+
+static const std::array<std::array<uint32_t, 256>, 8> crcTable = buildTables();
+
+uint32_t crc32(const void* data, size_t len, uint32_t crc) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    while (len >= 8) {
+        uint32_t lo = crc ^ (uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24);
+        crc = crcTable[7][lo & 0xff] ^ crcTable[6][(lo >> 8) & 0xff] ^
+              crcTable[5][(lo >> 16) & 0xff] ^ crcTable[4][lo >> 24] ^
+              crcTable[3][p[4]] ^ crcTable[2][p[5]] ^ crcTable[1][p[6]] ^ crcTable[0][p[7]];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = crcTable[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,281 @@
+#include "../include/EventLoop.h"
+#include "../include/RedisCommandHandler.h"
+#include "../include/ServerConfig.h"
+#include "../include/AppendOnlyFile.h"
+#include "../include/ServerStats.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <iostream>
+
+static const int MAX_EVENTS = 256;
+static const int EPOLL_TIMEOUT_MS = 100; // Bound on how long shutdown waits for the loop
+static const size_t READ_CHUNK = 16 * 1024;
+// An input buffer emptied by processing keeps its capacity only up to this
+// many bytes; idle connections then cost no input buffer at all
+static const size_t INBUF_KEEP = 1024;
+static const int MAX_IOVECS = 64;
+// Once this many reply bytes are waiting on a client, stop running its
+// commands and stop reading its socket until it drains; TCP flow control
+// then pushes back on the sender instead of the server buffering for it.
+static const size_t OUTPUT_SOFT_LIMIT = 256 * 1024;
+
+EventLoop::EventLoop(int listen_fd, RedisCommandHandler& cmdHandler)
+    : epoll_fd(epoll_create1(EPOLL_CLOEXEC)), listen_fd(listen_fd), cmdHandler(cmdHandler),
+      outputLimit(ServerConfig::getInstance().outputBufferLimit), readBuf(new char[READ_CHUNK]) {
+    if (epoll_fd < 0) {
+        std::cerr << "Error creating epoll instance\n";
+        return;
+    }
+    struct epoll_event ev {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = nullptr; // nullptr marks the listening socket
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+        std::cerr << "Error registering listening socket with epoll\n";
+}
+
+EventLoop::~EventLoop() {
+    for (auto& entry : connections) {
+        close(entry.first);
+    }
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+void EventLoop::run(const std::atomic<bool>& running) {
+    if (epoll_fd < 0) return;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (running) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, EPOLL_TIMEOUT_MS);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed\n";
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+            if (!conn) {
+                acceptClients();
+                continue;
+            }
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(*conn);
+                continue;
+            }
+            bool readable = events[i].events & EPOLLIN;
+            if ((events[i].events & EPOLLOUT) && !conn->flushPending) {
+                if (!flushOutput(*conn)) continue; // Connection was closed
+                if (conn->readPaused && conn->reply.pending() < OUTPUT_SOFT_LIMIT) {
+                    // Caught up: run what is buffered and read what arrived meanwhile
+                    conn->readPaused = false;
+                    readable = true;
+                }
+            }
+            // A client that shut its side still gets its buffered commands run
+            if (readable || conn->peerClosed) {
+                handleRead(*conn);
+            }
+        }
+        commitPending();
+    }
+}
+
+// Group commit: write the append only file once for every write command
+// this iteration ran (and, with appendfsync always, wait for the fsync),
+// then send the replies that were held back for it.
+void EventLoop::commitPending() {
+    while (!pendingFlush.empty()) {
+        AppendOnlyFile::getInstance().flush(cmdHandler.aofOffset());
+        std::vector<int> fds;
+        fds.swap(pendingFlush);
+        for (int fd : fds) {
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            Connection& conn = *it->second;
+            conn.flushPending = false;
+            if (!flushOutput(conn)) continue;
+            if (conn.readPaused && conn.reply.pending() < OUTPUT_SOFT_LIMIT) {
+                // Stopped at the soft limit: carry on with the rest of its input
+                conn.readPaused = false;
+                handleRead(conn);
+            } else {
+                closeIfDone(conn);
+            }
+        }
+    }
+}
+
+// "ip:port" of an accepted client
+static std::string peerName(const sockaddr_storage& addr) {
+    char host[INET6_ADDRSTRLEN] = "?";
+    int port = 0;
+    if (addr.ss_family == AF_INET) {
+        const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
+        inet_ntop(AF_INET, &in.sin_addr, host, sizeof(host));
+        port = ntohs(in.sin_port);
+    } else if (addr.ss_family == AF_INET6) {
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(addr);
+        inet_ntop(AF_INET6, &in6.sin6_addr, host, sizeof(host));
+        port = ntohs(in6.sin6_port);
+    }
+    return std::string(host) + ":" + std::to_string(port);
+}
+
+void EventLoop::acceptClients() {
+    // Edge-triggered: drain the accept queue until it would block.
+    while (true) {
+        sockaddr_storage peer {};
+        socklen_t peerLen = sizeof(peer);
+        int client_fd = accept4(listen_fd, reinterpret_cast<sockaddr*>(&peer), &peerLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                std::cerr << "accept failed\n";
+            return;
+        }
+
+        int opt = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        auto conn = std::make_unique<Connection>(client_fd, peerName(peer));
+        struct epoll_event ev {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn.get();
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            std::cerr << "Error registering client socket with epoll\n";
+            close(client_fd);
+            continue;
+        }
+        connections.emplace(client_fd, std::move(conn));
+        ServerStats::local().connectionsReceived.add();
+    }
+}
+
+void EventLoop::handleRead(Connection& conn) {
+    if (conn.readPaused) return; // Resumed from the EPOLLOUT path
+
+    // Edge-triggered: read until the socket would block or the client shuts
+    // its side. Reads land in the loop's buffer and only the bytes received
+    // are appended to inbuf.
+    while (!conn.peerClosed) {
+        ssize_t bytes = recv(conn.fd, readBuf.get(), READ_CHUNK, 0);
+        if (bytes > 0) {
+            conn.inbuf.append(readBuf.get(), bytes);
+            ServerStats::local().netInputBytes.add(bytes);
+            continue;
+        }
+        if (bytes == 0) {
+            conn.peerClosed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            closeConnection(conn);
+            return;
+        }
+        break;
+    }
+
+    if (!processInput(conn)) return;
+    closeIfDone(conn);
+}
+
+// Close a client that shut its side once nothing it sent is left to run
+// and every reply has gone out (including those held for the append only
+// file). Returns true if the connection was closed.
+bool EventLoop::closeIfDone(Connection& conn) {
+    if (!conn.peerClosed || conn.flushPending || conn.readPaused || !conn.reply.empty()) return false;
+    closeConnection(conn);
+    return true;
+}
+
+// Run the complete commands in the input buffer and write their replies.
+// A trailing partial frame stays in inbuf for the next read, and replies for
+// the whole batch go out together. Returns false if the connection was closed.
+bool EventLoop::processInput(Connection& conn) {
+    uint64_t aofBefore = cmdHandler.aofOffset();
+    while (true) {
+        RespParser::Status status = RespParser::Status::NeedMore;
+        while (conn.reply.pending() < OUTPUT_SOFT_LIMIT) {
+            status = conn.parser.next(conn.inbuf, conn.args);
+            if (status != RespParser::Status::Command) break;
+            cmdHandler.executeCommand(conn.args, conn.reply, conn.addr);
+        }
+        if (status == RespParser::Status::Error)
+            conn.reply.addError("ERR Protocol error: " + conn.parser.error());
+        conn.inbuf.erase(0, conn.parser.consumed());
+        conn.parser.compact();
+        if (conn.inbuf.empty() && conn.inbuf.capacity() > INBUF_KEEP) std::string().swap(conn.inbuf);
+
+        if (conn.reply.pending() > outputLimit) {
+            std::cerr << "Closing client: output buffer exceeds " << outputLimit << " bytes\n";
+            closeConnection(conn);
+            return false;
+        }
+        if (conn.flushPending || cmdHandler.aofOffset() != aofBefore) {
+            // Logged writes: the replies wait for commitPending()
+            if (status == RespParser::Status::Error) {
+                AppendOnlyFile::getInstance().flush(cmdHandler.aofOffset());
+                if (flushOutput(conn)) closeConnection(conn);
+                return false;
+            }
+            if (!conn.flushPending) {
+                conn.flushPending = true;
+                pendingFlush.push_back(conn.fd);
+            }
+            if (status != RespParser::Status::NeedMore || conn.reply.pending() >= OUTPUT_SOFT_LIMIT)
+                conn.readPaused = true;
+            return true;
+        }
+        if (!flushOutput(conn)) return false;
+        if (status == RespParser::Status::Error) {
+            closeConnection(conn);
+            return false;
+        }
+        if (conn.reply.pending() >= OUTPUT_SOFT_LIMIT) {
+            conn.readPaused = true;
+            return true;
+        }
+        // Stopped only because of the soft limit and the socket took it all:
+        // keep going with the rest of the batch.
+        if (status == RespParser::Status::NeedMore) return true;
+    }
+}
+
+// Write as much of the pending output as the socket accepts, gathering the
+// reply chunks with one sendmsg (writev) per batch. Returns false if the
+// connection had to be closed.
+bool EventLoop::flushOutput(Connection& conn) {
+    while (!conn.reply.empty()) {
+        struct iovec iov[MAX_IOVECS];
+        struct msghdr msg {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = conn.reply.fillIovec(iov, MAX_IOVECS);
+
+        ssize_t bytes = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+        if (bytes > 0) {
+            conn.reply.consume(bytes);
+            ServerStats::local().netOutputBytes.add(bytes);
+            continue;
+        }
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true; // EPOLLOUT fires once the socket drains
+        closeConnection(conn);
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::closeConnection(Connection& conn) {
+    int fd = conn.fd;
+    close(fd); // Also removes the fd from the epoll set
+    connections.erase(fd);
+    ServerStats::local().connectionsClosed.add();
+}
@@ -0,0 +1,89 @@
+#include "../include/Eviction.h"
+#include "../include/ServerConfig.h"
+#include <random>
+
+static const uint32_t LRU_CLOCK_MAX = (1u << 24) - 1;
+static const int64_t LRU_CLOCK_RESOLUTION_MS = 100;
+
+bool parseEvictionPolicy(const std::string& name, EvictionPolicy& policy) {
+    if (name == "noeviction") policy = EvictionPolicy::NoEviction;
+    else if (name == "allkeys-lru") policy = EvictionPolicy::AllKeysLru;
+    else if (name == "volatile-lru") policy = EvictionPolicy::VolatileLru;
+    else if (name == "allkeys-lfu") policy = EvictionPolicy::AllKeysLfu;
+    else if (name == "volatile-ttl") policy = EvictionPolicy::VolatileTtl;
+    else return false;
+    return true;
+}
+
+EvictionPolicy evictionPolicy() {
+    // Fixed at startup; parsed once so the access path only loads a static
+    static const EvictionPolicy policy = [] {
+        EvictionPolicy p = EvictionPolicy::NoEviction;
+        parseEvictionPolicy(ServerConfig::getInstance().maxmemoryPolicy, p);
+        return p;
+    }();
+    return policy;
+}
+
+static uint32_t lruClock(int64_t nowMs) {
+    return static_cast<uint32_t>(nowMs / LRU_CLOCK_RESOLUTION_MS) & LRU_CLOCK_MAX;
+}
+
+static uint32_t lfuMinutes(int64_t nowMs) {
+    return static_cast<uint32_t>(nowMs / 60000) & 0xFFFF;
+}
+
+// Counter stored in `access`, decayed by the minutes passed since
+static uint8_t decayedCounter(uint32_t access, int64_t nowMs) {
+    uint32_t counter = access & 0xFF;
+    uint32_t elapsed = (lfuMinutes(nowMs) - (access >> 8)) & 0xFFFF;
+    int decayTime = ServerConfig::getInstance().lfuDecayTime;
+    if (decayTime <= 0) return counter;
+    uint32_t periods = elapsed / decayTime;
+    return periods >= counter ? 0 : counter - periods;
+}
+
+uint32_t initialAccess(int64_t nowMs) {
+    if (evictionPolicy() == EvictionPolicy::AllKeysLfu) return (lfuMinutes(nowMs) << 8) | LFU_INIT_VAL;
+    return lruClock(nowMs);
+}
+
+void touchEntry(const KeyEntry& entry, int64_t nowMs) {
+    if (evictionPolicy() != EvictionPolicy::AllKeysLfu) {
+        // Skip the store when it would not change anything, so readers of
+        // a hot key do not keep writing the same cache line
+        uint32_t clock = lruClock(nowMs);
+        if (entry.access.load(std::memory_order_relaxed) != clock)
+            entry.access.store(clock, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t counter = decayedCounter(entry.access.load(std::memory_order_relaxed), nowMs);
+    if (counter < 255) {
+        thread_local std::minstd_rand rng(std::random_device{}());
+        double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+        double p = 1.0 / (base * ServerConfig::getInstance().lfuLogFactor + 1);
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < p) counter++;
+    }
+    // Racing readers may lose an increment; the counter is an estimate anyway
+    entry.access.store((lfuMinutes(nowMs) << 8) | counter, std::memory_order_relaxed);
+}
+
+uint8_t lfuCounter(const KeyEntry& entry, int64_t nowMs) {
+    return decayedCounter(entry.access.load(std::memory_order_relaxed), nowMs);
+}
+
+uint64_t evictionScore(const KeyEntry& entry, EvictionPolicy policy, int64_t nowMs) {
+    switch (policy) {
+        case EvictionPolicy::AllKeysLfu:
+            return 255 - lfuCounter(entry, nowMs);
+        case EvictionPolicy::VolatileTtl:
+            // Nearest deadline first
+            return UINT64_MAX - static_cast<uint64_t>(entry.expireAt);
+        default: {
+            // Idle time, allowing for the clock wrapping around
+            uint32_t idle = (lruClock(nowMs) - entry.access.load(std::memory_order_relaxed)) & LRU_CLOCK_MAX;
+            return static_cast<uint64_t>(idle) * LRU_CLOCK_RESOLUTION_MS;
+        }
+    }
+}
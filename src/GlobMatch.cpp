@@ -0,0 +1,71 @@
+#include "../include/GlobMatch.h"
+#include <utility>
+
+// Match one character class at `p` (just past '[') against `c`. Sets `end`
+// to the position after the closing ']' (or the end of the pattern if
+// there is none, in which case the class runs to the end).
+static bool matchClass(std::string_view pattern, size_t p, char c, size_t& end) {
+    bool negate = p < pattern.size() && pattern[p] == '^';
+    if (negate) p++;
+    bool matched = false;
+    while (p < pattern.size() && pattern[p] != ']') {
+        if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+            if (pattern[p + 1] == c) matched = true;
+            p += 2;
+        } else if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']') {
+            char lo = pattern[p], hi = pattern[p + 2];
+            if (lo > hi) std::swap(lo, hi);
+            if (c >= lo && c <= hi) matched = true;
+            p += 3;
+        } else {
+            if (pattern[p] == c) matched = true;
+            p++;
+        }
+    }
+    end = p < pattern.size() ? p + 1 : p;
+    return matched != negate;
+}
+
+bool globMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    // Where to resume after the last '*': the pattern just past it, and the
+    // next text position it should try to absorb
+    size_t starP = std::string_view::npos, starT = 0;
+
+    while (t < text.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+            if (pc == '*') {
+                // Consecutive stars are one star
+                while (p < pattern.size() && pattern[p] == '*') p++;
+                if (p == pattern.size()) return true;
+                starP = p;
+                starT = t;
+                continue;
+            }
+            size_t next = p + 1;
+            bool ok;
+            if (pc == '?') {
+                ok = true;
+            } else if (pc == '[') {
+                ok = matchClass(pattern, p + 1, text[t], next);
+            } else if (pc == '\\' && p + 1 < pattern.size()) {
+                ok = pattern[p + 1] == text[t];
+                next = p + 2;
+            } else {
+                ok = pc == text[t];
+            }
+            if (ok) {
+                p = next;
+                t++;
+                continue;
+            }
+        }
+        // Mismatch: let the last star absorb one more character
+        if (starP == std::string_view::npos) return false;
+        p = starP;
+        t = ++starT;
+    }
+    while (p < pattern.size() && pattern[p] == '*') p++;
+    return p == pattern.size();
+}
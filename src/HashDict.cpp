@@ -0,0 +1,111 @@
+#include "../include/HashDict.h"
+#include <functional>
+
+HashDict::Node* const HashDict::TOMBSTONE = reinterpret_cast<HashDict::Node*>(uintptr_t(1));
+
+static const size_t NOT_FOUND = SIZE_MAX;
+
+HashDict::~HashDict() {
+    for (Slot& slot : slots) {
+        if (isLive(slot.node)) delete slot.node;
+    }
+}
+
+uint64_t HashDict::hashField(std::string_view field) {
+    return std::hash<std::string_view>()(field);
+}
+
+uint64_t HashDict::reverseBits(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(v);
+}
+
+size_t HashDict::findSlot(std::string_view field, uint64_t hash) const {
+    if (slots.empty()) return NOT_FOUND;
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.node == nullptr) return NOT_FOUND;
+        if (slot.node != TOMBSTONE && slot.hash == hash && slot.node->field == field) return i;
+    }
+}
+
+const std::string* HashDict::find(std::string_view field) const {
+    size_t i = findSlot(field, hashField(field));
+    return i == NOT_FOUND ? nullptr : &slots[i].node->value;
+}
+
+int HashDict::set(std::string_view field, std::string_view value) {
+    uint64_t hash = hashField(field);
+    size_t i = findSlot(field, hash);
+    if (i != NOT_FOUND) {
+        std::string& stored = slots[i].node->value;
+        if (stored == value) return 0;
+        stored.assign(value.data(), value.size());
+        return 1;
+    }
+
+    // Keep live fields plus tombstones under 3/4 of the slots so probe
+    // sequences stay short and always reach an empty slot
+    if ((used + tombstones + 1) * 4 > slots.size() * 3) reserve(used + 1);
+    size_t mask = slots.size() - 1;
+    for (i = hash & mask; isLive(slots[i].node); i = (i + 1) & mask) {}
+    if (slots[i].node == TOMBSTONE) tombstones--;
+    slots[i].hash = hash;
+    slots[i].node = new Node{std::string(field), std::string(value)};
+    used++;
+    return 1;
+}
+
+bool HashDict::erase(std::string_view field) {
+    size_t i = findSlot(field, hashField(field));
+    if (i == NOT_FOUND) return false;
+    delete slots[i].node;
+    slots[i].node = TOMBSTONE;
+    used--;
+    tombstones++;
+    // Give memory back once the table is mostly empty
+    if (slots.size() > MIN_CAPACITY && used * 8 < slots.size()) {
+        size_t capacity = MIN_CAPACITY;
+        while (used * 2 > capacity) capacity *= 2;
+        resize(capacity);
+    }
+    return true;
+}
+
+void HashDict::reserve(size_t count) {
+    // Half full at most after the resize
+    size_t capacity = MIN_CAPACITY;
+    while (count * 2 > capacity) capacity *= 2;
+    if (capacity < slots.size()) capacity = slots.size();
+    // Same size: only clears the tombstones
+    if (capacity == slots.size() && (used + tombstones + 1) * 4 <= slots.size() * 3) return;
+    resize(capacity);
+}
+
+void HashDict::resize(size_t capacity) {
+    std::vector<Slot> old(capacity);
+    old.swap(slots);
+    tombstones = 0;
+    size_t mask = capacity - 1;
+    for (const Slot& slot : old) {
+        if (!isLive(slot.node)) continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].node != nullptr) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+size_t HashDict::memoryUsage() const {
+    // The slot array, then a node per field and any string too long to be inline
+    size_t total = sizeof(*this) + slots.capacity() * sizeof(Slot);
+    for (const Slot& slot : slots) {
+        if (!isLive(slot.node)) continue;
+        total += sizeof(Node);
+        if (slot.node->field.capacity() > 15) total += slot.node->field.capacity() + 1;
+        if (slot.node->value.capacity() > 15) total += slot.node->value.capacity() + 1;
+    }
+    return total;
+}
@@ -0,0 +1,109 @@
+#include "../include/HashObject.h"
+#include "../include/ServerConfig.h"
+
+size_t HashObject::findPacked(std::string_view field) const {
+    for (size_t pos = packed.first(); pos != packed.end(); ) {
+        if (packed.get(pos) == field) return pos;
+        pos = packed.next(packed.next(pos));
+    }
+    return packed.end();
+}
+
+void HashObject::convertToDict() {
+    auto map = std::make_unique<HashDict>();
+    map->reserve(size());
+    forEach([&](std::string_view field, std::string_view value) {
+        map->set(field, value);
+    });
+    dict = std::move(map);
+    packed = Listpack();
+}
+
+bool HashObject::loadListpack(std::string_view raw) {
+    dict.reset();
+    if (!packed.assign(raw) || packed.size() % 2 != 0) {
+        packed.clear();
+        return false;
+    }
+    const ServerConfig& config = ServerConfig::getInstance();
+    bool fits = size() <= config.hashMaxListpackEntries;
+    for (size_t pos = packed.first(); fits && pos != packed.end(); pos = packed.next(pos)) {
+        fits = packed.get(pos).size() <= config.hashMaxListpackValue;
+    }
+    if (!fits) convertToDict();
+    return true;
+}
+
+bool HashObject::get(std::string_view field, std::string& value) const {
+    if (dict) {
+        const std::string* stored = dict->find(field);
+        if (!stored) return false;
+        value = *stored;
+        return true;
+    }
+    size_t pos = findPacked(field);
+    if (pos == packed.end()) return false;
+    value.assign(packed.get(packed.next(pos)));
+    return true;
+}
+
+bool HashObject::exists(std::string_view field) const {
+    if (dict) return dict->find(field) != nullptr;
+    return findPacked(field) != packed.end();
+}
+
+int HashObject::set(std::string_view field, std::string_view value) {
+    if (!dict) {
+        const ServerConfig& config = ServerConfig::getInstance();
+        size_t pos = findPacked(field);
+        bool fits = field.size() <= config.hashMaxListpackValue && value.size() <= config.hashMaxListpackValue;
+        if (fits && pos != packed.end()) {
+            size_t valuePos = packed.next(pos);
+            if (packed.get(valuePos) == value) return 0;
+            packed.replace(valuePos, value);
+            return 1;
+        }
+        if (fits && size() < config.hashMaxListpackEntries) {
+            packed.pushBack(field);
+            packed.pushBack(value);
+            return 1;
+        }
+        convertToDict();
+    }
+
+    return dict->set(field, value);
+}
+
+bool HashObject::del(std::string_view field) {
+    if (dict) return dict->erase(field);
+    size_t pos = findPacked(field);
+    if (pos == packed.end()) return false;
+    packed.erase(packed.erase(pos));
+    return true;
+}
+
+size_t HashObject::memoryUsage() const {
+    size_t total = sizeof(HashObject) + packed.allocated();
+    if (dict) total += dict->memoryUsage();
+    return total;
+}
+
+uint64_t HashObject::scan(uint64_t cursor, size_t count,
+                          const std::function<void(std::string_view, std::string_view)>& fn) const {
+    if (!dict) {
+        forEach(fn);
+        return 0;
+    }
+    // Steps visit one home slot each, mostly empty in a sparse table, so
+    // bound them too
+    size_t emitted = 0;
+    auto emit = [&](std::string_view field, std::string_view value) {
+        fn(field, value);
+        emitted++;
+    };
+    for (size_t steps = 0; steps < count * 10; steps++) {
+        cursor = dict->scan(cursor, emit);
+        if (cursor == 0 || emitted >= count) break;
+    }
+    return cursor;
+}
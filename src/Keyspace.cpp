@@ -0,0 +1,354 @@
+#include "../include/Keyspace.h"
+#include "../include/Eviction.h"
+#include "../include/Memory.h"
+#include "../include/LatencyMonitor.h"
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <cstdint>
+
+static const size_t MIN_CAPACITY = 16;
+static const size_t NOT_FOUND = static_cast<size_t>(-1);
+// Entries moved to the new slot array by each insert or remove during a resize
+static const size_t REHASH_STEP = 4;
+
+KeyEntry* const KeyspaceTable::TOMBSTONE = reinterpret_cast<KeyEntry*>(uintptr_t(1));
+
+const char* typeName(ObjectType type) {
+    switch (type) {
+        case ObjectType::String: return "string";
+        case ObjectType::List:   return "list";
+        case ObjectType::Hash:   return "hash";
+    }
+    return "none";
+}
+
+// A string value too long to embed: length and capacity, then the bytes
+struct HeapString {
+    uint32_t length;
+    uint32_t capacity;
+    char* bytes() { return reinterpret_cast<char*>(this + 1); }
+    const char* bytes() const { return reinterpret_cast<const char*>(this + 1); }
+};
+
+KeyEntry* KeyEntry::create(SlabAllocator& slab, std::string_view key, KeyValue&& value) {
+    size_t room = 0;
+    if (value.index() == 0) {
+        // Embed the string if the whole entry fits in a slab chunk, and let
+        // it grow into the rest of the chunk later
+        size_t length = std::get<0>(value).size();
+        size_t size = sizeof(KeyEntry) + std::max(length, sizeof(void*)) + key.size();
+        if (size <= SLAB_MAX_OBJECT) room = slabChunkSize(size) - sizeof(KeyEntry) - key.size();
+    }
+    size_t size = sizeof(KeyEntry) + std::max(room, sizeof(void*)) + key.size();
+    bool inSlab = size <= SLAB_MAX_OBJECT;
+    KeyEntry* entry = new (inSlab ? slab.allocate(size) : ::operator new(size)) KeyEntry();
+    entry->keyLen = static_cast<uint32_t>(key.size());
+    entry->room = static_cast<uint8_t>(room);
+    if (inSlab) entry->flags |= IN_SLAB;
+    memcpy(entry->storage() + entry->valueRoom(), key.data(), key.size());
+    entry->setValue(std::move(value));
+    return entry;
+}
+
+void KeyEntry::destroy(KeyEntry* entry) {
+    entry->freeValue();
+    bool inSlab = entry->inSlab();
+    entry->~KeyEntry();
+    if (inSlab)
+        SlabAllocator::deallocate(entry);
+    else
+        ::operator delete(entry);
+}
+
+KeyEntry* KeyEntry::relocate(SlabAllocator& slab) {
+    size_t size = allocationSize();
+    void* moved = slab.allocate(size);
+    memcpy(moved, static_cast<const void*>(this), size);
+    SlabAllocator::deallocate(this);
+    return static_cast<KeyEntry*>(moved);
+}
+
+void KeyEntry::freeValue() {
+    switch (tag) {
+        case ObjectType::String:
+            if (!(flags & EMBEDDED)) ::operator delete(pointer());
+            break;
+        case ObjectType::List: delete &list(); break;
+        case ObjectType::Hash: delete &hash(); break;
+    }
+    tag = ObjectType::String;
+    flags |= EMBEDDED;
+    embeddedLen = 0;
+}
+
+std::string_view KeyEntry::str() const {
+    if (flags & EMBEDDED) return {storage(), embeddedLen};
+    const HeapString* heap = static_cast<const HeapString*>(pointer());
+    return {heap->bytes(), heap->length};
+}
+
+void KeyEntry::setString(std::string_view value) {
+    if (tag != ObjectType::String) freeValue();
+    HeapString* heap = (flags & EMBEDDED) ? nullptr : static_cast<HeapString*>(pointer());
+    if (value.size() <= valueRoom()) {
+        memmove(storage(), value.data(), value.size());
+        if (heap) ::operator delete(heap);
+        flags |= EMBEDDED;
+        embeddedLen = static_cast<uint32_t>(value.size());
+        return;
+    }
+    // Reuse the out-of-line buffer unless it is too small or mostly unused
+    if (!heap || heap->capacity < value.size() || heap->capacity / 2 > value.size()) {
+        HeapString* fresh = static_cast<HeapString*>(::operator new(sizeof(HeapString) + value.size()));
+        fresh->capacity = static_cast<uint32_t>(value.size());
+        memcpy(fresh->bytes(), value.data(), value.size());
+        if (heap) ::operator delete(heap);
+        heap = fresh;
+        setPointer(heap);
+        flags &= ~EMBEDDED;
+    } else {
+        memmove(heap->bytes(), value.data(), value.size());
+    }
+    heap->length = static_cast<uint32_t>(value.size());
+}
+
+void KeyEntry::setValue(KeyValue&& value) {
+    switch (value.index()) {
+        case 0:
+            setString(std::get<0>(value));
+            return;
+        case 1:
+            freeValue();
+            setPointer(std::get<1>(value).release());
+            tag = ObjectType::List;
+            break;
+        case 2:
+            freeValue();
+            setPointer(std::get<2>(value).release());
+            tag = ObjectType::Hash;
+            break;
+    }
+    flags &= ~EMBEDDED;
+}
+
+KeyValue KeyEntry::takeValue() {
+    KeyValue value;
+    switch (tag) {
+        case ObjectType::String:
+            value = std::string(str());
+            freeValue();
+            return value;
+        case ObjectType::List: value = std::unique_ptr<RedisList>(&list()); break;
+        case ObjectType::Hash: value = std::unique_ptr<RedisHash>(&hash()); break;
+    }
+    // The collection now belongs to `value`
+    tag = ObjectType::String;
+    flags |= EMBEDDED;
+    embeddedLen = 0;
+    return value;
+}
+
+size_t KeyEntry::memoryUsage() const {
+    // The entry itself plus its table slot
+    size_t total = (inSlab() ? slabChunkSize(allocationSize()) : allocationSize()) + 2 * sizeof(void*);
+    switch (type()) {
+        case ObjectType::String:
+            if (!(flags & EMBEDDED))
+                total += sizeof(HeapString) + static_cast<const HeapString*>(pointer())->capacity;
+            break;
+        case ObjectType::List: total += list().memoryUsage(); break;
+        case ObjectType::Hash: total += hash().memoryUsage(); break;
+    }
+    return total;
+}
+
+uint64_t hashKey(std::string_view key) {
+    return std::hash<std::string_view>()(key);
+}
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t unixNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+KeyspaceTable::~KeyspaceTable() {
+    clear();
+    slab->release();
+}
+
+void KeyspaceTable::clear() {
+    for (auto* table : {&slots, &old}) {
+        for (auto& slot : *table) {
+            if (isLive(slot.entry)) KeyEntry::destroy(slot.entry);
+        }
+        *table = SlotArray();
+    }
+    migrated = 0;
+    oldUsed = 0;
+    used = 0;
+    tombstones = 0;
+}
+
+void KeyspaceTable::swap(KeyspaceTable& other) noexcept {
+    slots.swap(other.slots);
+    old.swap(other.old);
+    std::swap(migrated, other.migrated);
+    std::swap(oldUsed, other.oldUsed);
+    std::swap(used, other.used);
+    std::swap(tombstones, other.tombstones);
+    std::swap(slab, other.slab);
+}
+
+KeyspaceTable::SlotArray::SlotArray(size_t n)
+    : data(static_cast<Slot*>(allocZeroed(n * sizeof(Slot)))), count(n) {}
+
+KeyspaceTable::SlotArray::~SlotArray() {
+    if (data) freeZeroed(data);
+}
+
+size_t KeyspaceTable::findSlot(const SlotArray& table, std::string_view key, uint64_t hash) {
+    if (table.empty()) return NOT_FOUND;
+    size_t mask = table.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const Slot& slot = table[i];
+        if (slot.entry == nullptr) return NOT_FOUND;
+        if (slot.entry != TOMBSTONE && slot.hash == hash && slot.entry->key() == key) return i;
+    }
+}
+
+uint64_t KeyspaceTable::reverseBits(uint64_t v) {
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(v);
+}
+
+KeyEntry* KeyspaceTable::find(std::string_view key, uint64_t hash) const {
+    size_t i = findSlot(slots, key, hash);
+    if (i != NOT_FOUND) return slots[i].entry;
+    if (old.empty()) return nullptr;
+    i = findSlot(old, key, hash);
+    return i == NOT_FOUND ? nullptr : old[i].entry;
+}
+
+KeyEntry* KeyspaceTable::insert(std::string_view key, uint64_t hash, KeyValue&& value) {
+    if (!old.empty()) rehash(REHASH_STEP);
+
+    // Keep live entries plus tombstones under 3/4 of the slots so probe
+    // sequences stay short and always reach an empty slot.
+    size_t newUsed = used - oldUsed;
+    if ((newUsed + tombstones + 1) * 4 > slots.size() * 3) {
+        LatencyTimer stall("rehash");
+        // The steps above normally finish a resize long before the new
+        // array fills up; if not, finish it now before starting another
+        if (!old.empty()) {
+            rehash(SIZE_MAX);
+            newUsed = used;
+        }
+        if ((newUsed + tombstones + 1) * 4 > slots.size() * 3) {
+            size_t capacity = slots.empty() ? MIN_CAPACITY : slots.size();
+            while ((used + 1) * 2 > capacity) capacity *= 2;
+            startResize(capacity);
+        }
+    }
+
+    KeyEntry* entry = KeyEntry::create(*slab, key, std::move(value));
+    entry->access.store(initialAccess(steadyNowMs()), std::memory_order_relaxed);
+    place(Slot{hash, entry});
+    used++;
+    return entry;
+}
+
+KeyEntryPtr KeyspaceTable::remove(std::string_view key, uint64_t hash) {
+    if (!old.empty()) rehash(REHASH_STEP);
+
+    size_t i = findSlot(slots, key, hash);
+    if (i != NOT_FOUND) {
+        KeyEntryPtr entry(slots[i].entry);
+        slots[i].entry = TOMBSTONE;
+        used--;
+        tombstones++;
+        return entry;
+    }
+    if (old.empty()) return nullptr;
+    i = findSlot(old, key, hash);
+    if (i == NOT_FOUND) return nullptr;
+    KeyEntryPtr entry(old[i].entry);
+    old[i].entry = TOMBSTONE;
+    used--;
+    oldUsed--;
+    finishRehashIfDone();
+    return entry;
+}
+
+void KeyspaceTable::reserve(size_t count) {
+    size_t capacity = slots.empty() ? MIN_CAPACITY : slots.size();
+    while (count * 2 > capacity) capacity *= 2;
+    if (capacity <= slots.size()) return;
+    // Bulk loading: resize in one go rather than spread over the inserts
+    rehash(SIZE_MAX);
+    startResize(capacity);
+    rehash(SIZE_MAX);
+}
+
+void KeyspaceTable::startResize(size_t capacity) {
+    old.swap(slots);
+    slots = SlotArray(capacity);
+    tombstones = 0;
+    migrated = 0;
+    oldUsed = used;
+    finishRehashIfDone();
+}
+
+void KeyspaceTable::place(const Slot& slot) {
+    size_t mask = slots.size() - 1;
+    size_t i = slot.hash & mask;
+    while (isLive(slots[i].entry)) i = (i + 1) & mask;
+    if (slots[i].entry == TOMBSTONE) tombstones--;
+    slots[i] = slot;
+}
+
+bool KeyspaceTable::rehash(size_t count) {
+    // Bound the empty slots visited too, so a sparse stretch of the old
+    // array does not turn one step into a long scan
+    size_t visits = count > SIZE_MAX / 10 ? SIZE_MAX : count * 10;
+    for (size_t moved = 0; oldUsed > 0 && moved < count && visits > 0; visits--) {
+        Slot& slot = old[migrated++];
+        if (!isLive(slot.entry)) continue;
+        place(slot);
+        // A tombstone keeps the probe sequences through this slot intact
+        // for lookups of the entries not moved yet
+        slot.entry = TOMBSTONE;
+        oldUsed--;
+        moved++;
+    }
+    finishRehashIfDone();
+    return !old.empty();
+}
+
+size_t KeyspaceTable::defrag(size_t& cursor, size_t count) {
+    size_t moved = 0;
+    size_t total = slots.size() + old.size();
+    for (size_t n = 0; n < count && cursor < total; n++, cursor++) {
+        Slot& slot = cursor < slots.size() ? slots[cursor] : old[cursor - slots.size()];
+        if (!isLive(slot.entry) || !slot.entry->inSlab() || !slab->shouldMove(slot.entry)) continue;
+        slot.entry = slot.entry->relocate(*slab);
+        moved++;
+    }
+    if (cursor >= total) cursor = 0;
+    return moved;
+}
+
+void KeyspaceTable::finishRehashIfDone() {
+    if (oldUsed > 0 || old.empty()) return;
+    old = SlotArray();
+    migrated = 0;
+}
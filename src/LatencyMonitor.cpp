@@ -0,0 +1,70 @@
+#include "../include/LatencyMonitor.h"
+#include "../include/ServerConfig.h"
+#include "../include/Keyspace.h"
+
+LatencyMonitor& LatencyMonitor::getInstance() {
+    static LatencyMonitor instance;
+    return instance;
+}
+
+LatencyMonitor::LatencyMonitor() : threshold(ServerConfig::getInstance().latencyMonitorThreshold) {}
+
+void LatencyMonitor::addSampleIfNeeded(std::string_view event, uint64_t ms) {
+    if (threshold == 0 || ms < threshold) return;
+    int64_t now = unixNowMs() / 1000;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = events.find(event);
+    if (it == events.end()) it = events.emplace(std::string(event), Series()).first;
+    Series& series = it->second;
+    if (ms > series.maxMs) series.maxMs = ms;
+    // Several stalls within one second share a sample, keeping the worst
+    if (series.count > 0) {
+        Sample& last = series.samples[(series.next + LATENCY_HISTORY_LEN - 1) % LATENCY_HISTORY_LEN];
+        if (last.time == now) {
+            if (ms > last.ms) last.ms = ms;
+            return;
+        }
+    }
+    series.samples[series.next] = {now, ms};
+    series.next = (series.next + 1) % LATENCY_HISTORY_LEN;
+    if (series.count < LATENCY_HISTORY_LEN) series.count++;
+}
+
+std::vector<LatencyMonitor::EventStats> LatencyMonitor::latest() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<EventStats> stats;
+    for (const auto& [name, series] : events) {
+        const Sample& last = series.samples[(series.next + LATENCY_HISTORY_LEN - 1) % LATENCY_HISTORY_LEN];
+        stats.push_back({name, last, series.maxMs});
+    }
+    return stats;
+}
+
+std::vector<LatencyMonitor::Sample> LatencyMonitor::history(std::string_view event) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Sample> samples;
+    auto it = events.find(event);
+    if (it == events.end()) return samples;
+    const Series& series = it->second;
+    for (size_t i = 0; i < series.count; i++)
+        samples.push_back(series.samples[(series.next + LATENCY_HISTORY_LEN - series.count + i) % LATENCY_HISTORY_LEN]);
+    return samples;
+}
+
+size_t LatencyMonitor::reset(const std::vector<std::string_view>& names) {
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t n = 0;
+    if (names.empty()) {
+        n = events.size();
+        events.clear();
+        return n;
+    }
+    for (std::string_view name : names) {
+        auto it = events.find(name);
+        if (it == events.end()) continue;
+        events.erase(it);
+        n++;
+    }
+    return n;
+}
@@ -0,0 +1,63 @@
+#include "../include/LazyFree.h"
+
+size_t freeEffort(const KeyEntry& entry) {
+    switch (entry.type()) {
+        case ObjectType::List:
+            return entry.list().nodeCount();
+        case ObjectType::Hash:
+            return entry.hash().listpack() ? 1 : entry.hash().size();
+        default:
+            return 1;
+    }
+}
+
+LazyFree& LazyFree::getInstance() {
+    static LazyFree instance;
+    return instance;
+}
+
+LazyFree::LazyFree() : worker(&LazyFree::run, this) {}
+
+LazyFree::~LazyFree() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cond.notify_one();
+    worker.join();
+}
+
+void LazyFree::freeEntry(KeyEntryPtr entry) {
+    if (freeEffort(*entry) <= LAZYFREE_THRESHOLD) return;     // Freed on return
+    enqueue(std::make_unique<Garbage<KeyEntryPtr>>(std::move(entry)), 1);
+}
+
+void LazyFree::enqueue(std::unique_ptr<Job> job, size_t objects) {
+    job->objects = objects;
+    pending += objects;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobs.push_back(std::move(job));
+    }
+    cond.notify_one();
+}
+
+void LazyFree::run() {
+    std::vector<std::unique_ptr<Job>> batch;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cond.wait(lock, [&] { return stopping || !jobs.empty(); });
+        // Anything still queued is freed by the destructor
+        if (stopping) return;
+        batch.swap(jobs);
+        lock.unlock();
+        for (auto& job : batch) {
+            size_t objects = job->objects;
+            job.reset();
+            pending -= objects;
+            freed += objects;
+        }
+        batch.clear();
+        lock.lock();
+    }
+}
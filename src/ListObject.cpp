@@ -0,0 +1,73 @@
+#include "../include/ListObject.h"
+#include "../include/ServerConfig.h"
+
+void ListObject::convertIfLarge() {
+    if (packed.bytes() <= ServerConfig::getInstance().listMaxListpackSize) return;
+    quick = std::make_unique<Quicklist>(std::move(packed));
+    packed = Listpack();
+}
+
+void ListObject::pushFront(std::string_view value) {
+    if (quick) return quick->pushFront(value);
+    packed.pushFront(value);
+    convertIfLarge();
+}
+
+void ListObject::pushBack(std::string_view value) {
+    if (quick) return quick->pushBack(value);
+    packed.pushBack(value);
+    convertIfLarge();
+}
+
+bool ListObject::loadListpack(std::string_view raw) {
+    quick.reset();
+    if (!packed.assign(raw)) return false;
+    convertIfLarge();
+    return true;
+}
+
+bool ListObject::popFront(std::string& value) {
+    if (quick) return quick->popFront(value);
+    if (packed.empty()) return false;
+    value.assign(packed.get(packed.first()));
+    packed.erase(packed.first());
+    return true;
+}
+
+bool ListObject::popBack(std::string& value) {
+    if (quick) return quick->popBack(value);
+    if (packed.empty()) return false;
+    size_t pos = packed.last();
+    value.assign(packed.get(pos));
+    packed.erase(pos);
+    return true;
+}
+
+bool ListObject::index(long index, std::string& value) const {
+    if (quick) return quick->index(index, value);
+    size_t pos = packed.seek(index);
+    if (pos == packed.end()) return false;
+    value.assign(packed.get(pos));
+    return true;
+}
+
+bool ListObject::set(long index, std::string_view value) {
+    if (quick) return quick->set(index, value);
+    size_t pos = packed.seek(index);
+    if (pos == packed.end()) return false;
+    packed.replace(pos, value);
+    convertIfLarge();
+    return true;
+}
+
+size_t ListObject::remove(long count, std::string_view value) {
+    if (quick) return quick->remove(count, value);
+    size_t max = count == 0 ? packed.size() : static_cast<size_t>(count < 0 ? -count : count);
+    return packed.removeMatching(value, max, count < 0);
+}
+
+size_t ListObject::memoryUsage() const {
+    size_t total = sizeof(ListObject) + packed.allocated();
+    if (quick) total += sizeof(Quicklist) + quick->memoryUsage();
+    return total;
+}
@@ -0,0 +1,188 @@
+#include "../include/Listpack.h"
+#include <cstring>
+
+// Lengths are LEB128: seven bits per byte, low group first, high bit set on
+// every byte but the last.
+static size_t varintSize(size_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static size_t writeVarint(char* out, size_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<char>(value);
+    return n;
+}
+
+static size_t readVarint(const char* in, size_t& value) {
+    value = 0;
+    size_t n = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = static_cast<uint8_t>(in[n++]);
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return n;
+}
+
+// The backlen is the same varint with its bytes in reverse order, so the
+// byte just before an entry's successor is the backlen's low group.
+static size_t writeBacklen(char* out, size_t value) {
+    char tmp[10];
+    size_t n = writeVarint(tmp, value);
+    for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    return n;
+}
+
+// `end` points one past the backlen's last byte
+static size_t readBacklen(const char* end, size_t& value) {
+    value = 0;
+    size_t n = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = static_cast<uint8_t>(*(end - 1 - n));
+        n++;
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return n;
+}
+
+size_t Listpack::entrySize(size_t len) {
+    size_t head = varintSize(len) + len;
+    return head + varintSize(head);
+}
+
+size_t Listpack::next(size_t pos) const {
+    size_t len;
+    size_t n = readVarint(buf.data() + pos, len);
+    return pos + n + len + varintSize(n + len);
+}
+
+size_t Listpack::prev(size_t pos) const {
+    size_t head;
+    size_t n = readBacklen(buf.data() + pos, head);
+    return pos - n - head;
+}
+
+std::string_view Listpack::get(size_t pos) const {
+    size_t len;
+    size_t n = readVarint(buf.data() + pos, len);
+    return std::string_view(buf.data() + pos + n, len);
+}
+
+size_t Listpack::seek(long index) const {
+    if (index < 0) index += count;
+    if (index < 0 || index >= static_cast<long>(count)) return buf.size();
+    size_t pos;
+    if (static_cast<size_t>(index) <= count / 2) {
+        pos = 0;
+        for (long i = 0; i < index; i++) pos = next(pos);
+    } else {
+        pos = buf.size();
+        for (long i = count; i > index; i--) pos = prev(pos);
+    }
+    return pos;
+}
+
+size_t Listpack::insert(size_t pos, std::string_view value) {
+    char head[10], tail[10];
+    size_t headLen = writeVarint(head, value.size());
+    size_t tailLen = writeBacklen(tail, headLen + value.size());
+    size_t total = headLen + value.size() + tailLen;
+
+    buf.insert(pos, total, '\0');
+    char* out = &buf[pos];
+    memcpy(out, head, headLen);
+    if (!value.empty()) memcpy(out + headLen, value.data(), value.size());
+    memcpy(out + headLen + value.size(), tail, tailLen);
+    count++;
+    return pos;
+}
+
+size_t Listpack::erase(size_t pos) {
+    buf.erase(pos, next(pos) - pos);
+    count--;
+    return pos;
+}
+
+size_t Listpack::replace(size_t pos, std::string_view value) {
+    size_t old = next(pos) - pos;
+    if (entrySize(value.size()) == old) {
+        // Same encoded size: overwrite the data in place
+        size_t len;
+        size_t n = readVarint(buf.data() + pos, len);
+        if (!value.empty()) memcpy(&buf[pos + n], value.data(), value.size());
+        return pos + old;
+    }
+    erase(pos);
+    insert(pos, value);
+    return next(pos);
+}
+
+bool Listpack::assign(std::string_view raw) {
+    // Walk the entries, checking that every length and backlen stays in
+    // bounds and agrees, before taking the bytes.
+    const char* p = raw.data();
+    size_t pos = 0;
+    size_t entries = 0;
+    while (pos < raw.size()) {
+        size_t len = 0;
+        size_t n = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            if (pos + n >= raw.size() || shift > 56) return false;
+            byte = static_cast<uint8_t>(p[pos + n++]);
+            len |= static_cast<size_t>(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        if (len > raw.size() - pos - n) return false;
+        size_t head = n + len;
+        size_t total = head + varintSize(head);
+        if (total > raw.size() - pos) return false;
+        char expected[10];
+        size_t tailLen = writeBacklen(expected, head);
+        if (memcmp(p + pos + head, expected, tailLen) != 0) return false;
+        pos += total;
+        entries++;
+    }
+    buf.assign(raw.data(), raw.size());
+    count = static_cast<uint32_t>(entries);
+    return true;
+}
+
+size_t Listpack::removeMatching(std::string_view value, size_t max, bool fromTail) {
+    size_t removed = 0;
+    if (!fromTail) {
+        for (size_t pos = first(); pos != end() && removed < max; ) {
+            if (get(pos) == value) {
+                pos = erase(pos);
+                removed++;
+            } else {
+                pos = next(pos);
+            }
+        }
+    } else {
+        // Erasing at `pos` leaves every entry before it where it was
+        for (size_t pos = end(); pos != first() && removed < max; ) {
+            pos = prev(pos);
+            if (get(pos) == value) {
+                erase(pos);
+                removed++;
+            }
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,132 @@
+#include "../include/Lzf.h"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+static const size_t HASH_BITS = 14;
+static const size_t MAX_LITERALS = 32;
+static const size_t MAX_OFFSET = 1 << 13;
+static const size_t MAX_MATCH = 264;        // 7 + 255 + 2
+
+static inline uint32_t hash3(const uint8_t* p) {
+    uint32_t v = uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2];
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Hash table reused by every call on a thread, so it is neither allocated
+// nor cleared per string. Each call's positions are stored shifted by
+// `base`, which then moves past them: an entry at or below the current
+// base was left by an earlier call and reads as empty. The table is only
+// cleared when the shifted positions would overflow.
+struct LzfTable {
+    std::vector<uint32_t> slots = std::vector<uint32_t>(1 << HASH_BITS, 0);
+    uint32_t base = 0;
+};
+
+bool lzfCompress(std::string_view input, std::string& out) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    size_t n = input.size();
+    if (n < 16 || n >= UINT32_MAX / 2) return false;
+
+    thread_local LzfTable hashTable;
+    if (hashTable.base > UINT32_MAX - n - 1) {
+        std::fill(hashTable.slots.begin(), hashTable.slots.end(), 0);
+        hashTable.base = 0;
+    }
+    // Position + 1 of the last occurrence of each 3-byte hash, plus base;
+    // base or below means none
+    uint32_t* table = hashTable.slots.data();
+    const uint32_t base = hashTable.base;
+    hashTable.base += static_cast<uint32_t>(n);
+
+    size_t start = out.size();
+    // Give up once the output is no smaller than the input
+    size_t limit = start + n - 4;
+    out.reserve(start + n);
+
+    size_t literalCtrl = std::string::npos;     // Offset of the open literal run's control byte
+
+    auto literal = [&](uint8_t byte) {
+        if (literalCtrl == std::string::npos) {
+            literalCtrl = out.size();
+            out.push_back(0);
+        } else {
+            out[literalCtrl]++;
+        }
+        out.push_back(static_cast<char>(byte));
+        if (static_cast<uint8_t>(out[literalCtrl]) == MAX_LITERALS - 1) literalCtrl = std::string::npos;
+    };
+
+    size_t ip = 0;
+    while (ip + 2 < n) {
+        if (out.size() >= limit) {
+            out.resize(start);
+            return false;
+        }
+        uint32_t h = hash3(in + ip);
+        size_t ref = table[h] > base ? table[h] - base : 0;
+        table[h] = static_cast<uint32_t>(base + ip + 1);
+
+        if (ref && ip - (ref - 1) <= MAX_OFFSET &&
+            in[ref - 1] == in[ip] && in[ref] == in[ip + 1] && in[ref + 1] == in[ip + 2]) {
+            size_t from = ref - 1;
+            size_t len = 3;
+            size_t maxLen = std::min(n - ip, MAX_MATCH);
+            while (len < maxLen && in[from + len] == in[ip + len]) len++;
+
+            size_t offset = ip - from - 1;
+            size_t code = len - 2;
+            if (code < 7) {
+                out.push_back(static_cast<char>((code << 5) | (offset >> 8)));
+            } else {
+                out.push_back(static_cast<char>((7 << 5) | (offset >> 8)));
+                out.push_back(static_cast<char>(code - 7));
+            }
+            out.push_back(static_cast<char>(offset & 0xff));
+            literalCtrl = std::string::npos;
+            ip += len;
+        } else {
+            literal(in[ip++]);
+        }
+    }
+    while (ip < n) literal(in[ip++]);
+
+    if (out.size() >= limit) {
+        out.resize(start);
+        return false;
+    }
+    return true;
+}
+
+bool lzfDecompress(std::string_view input, size_t rawLen, std::string& out) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    size_t n = input.size();
+    size_t base = out.size();
+    size_t end = base + rawLen;
+    out.resize(end);
+    char* dst = &out[0];
+    size_t op = base;
+
+    size_t ip = 0;
+    while (ip < n) {
+        size_t ctrl = in[ip++];
+        if (ctrl < MAX_LITERALS) {
+            size_t len = ctrl + 1;
+            if (ip + len > n || op + len > end) return false;
+            for (size_t i = 0; i < len; i++) dst[op++] = static_cast<char>(in[ip++]);
+        } else {
+            size_t len = ctrl >> 5;
+            if (len == 7) {
+                if (ip >= n) return false;
+                len += in[ip++];
+            }
+            len += 2;
+            if (ip >= n) return false;
+            size_t offset = ((ctrl & 0x1f) << 8) + in[ip++] + 1;
+            if (offset > op - base || op + len > end) return false;
+            // Byte by byte: the source may overlap what is being written
+            for (size_t i = 0; i < len; i++, op++) dst[op] = dst[op - offset];
+        }
+    }
+    return op == end;
+}
@@ -0,0 +1,144 @@
+#include "../include/Memory.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <mutex>
+#include <vector>
+#include <malloc.h>
+#include <sys/mman.h>
+
+// Every container and value in the server allocates through the global
+// operator new, so counting here covers the keyspace, client buffers and
+// everything else without touching the data structures themselves.
+//
+// Each thread counts into its own block, with a relaxed load and store
+// like StatCounter, so allocating never does an atomic read-modify-write
+// on a shared cache line; usedMemory() sums the blocks. Memory freed by
+// another thread than the one that allocated it (the lazy-free thread)
+// drives that thread's count negative: only the sum means anything.
+struct alignas(64) ThreadMemory {
+    std::atomic<int64_t> bytes{0};
+    ThreadMemory* next = nullptr;
+};
+
+// Blocks are never freed, so what a thread that exited allocated or freed
+// still adds up. They come from posix_memalign, which honours the cache
+// line alignment; operator new would count into the block being created.
+static std::atomic<ThreadMemory*> threadMemoryBlocks{nullptr};
+static thread_local ThreadMemory* threadMemory = nullptr;
+static thread_local uint64_t threadAllocations = 0;
+
+static ThreadMemory* registerThreadMemory() {
+    void* p = nullptr;
+    if (posix_memalign(&p, alignof(ThreadMemory), sizeof(ThreadMemory)) != 0) throw std::bad_alloc();
+    ThreadMemory* block = new (p) ThreadMemory;
+    block->next = threadMemoryBlocks.load(std::memory_order_relaxed);
+    while (!threadMemoryBlocks.compare_exchange_weak(block->next, block, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {}
+    return block;
+}
+
+static void count(int64_t bytes) {
+    if (!threadMemory) threadMemory = registerThreadMemory();
+    threadMemory->bytes.store(threadMemory->bytes.load(std::memory_order_relaxed) + bytes,
+                              std::memory_order_relaxed);
+}
+
+size_t usedMemory() {
+    int64_t total = 0;
+    for (ThreadMemory* block = threadMemoryBlocks.load(std::memory_order_acquire); block; block = block->next)
+        total += block->bytes.load(std::memory_order_relaxed);
+    // Blocks are read at slightly different times, so a free may be seen
+    // without its allocation
+    return total > 0 ? static_cast<size_t>(total) : 0;
+}
+
+uint64_t threadAllocationCount() {
+    return threadAllocations;
+}
+
+static void* countedAlloc(size_t size) {
+    threadAllocations++;
+    void* p = malloc(size ? size : 1);
+    if (p) count(static_cast<int64_t>(malloc_usable_size(p)));
+    return p;
+}
+
+static void countedFree(void* p) {
+    if (!p) return;
+    count(-static_cast<int64_t>(malloc_usable_size(p)));
+    free(p);
+}
+
+void* allocZeroed(size_t bytes) {
+    threadAllocations++;
+    void* p = calloc(1, bytes ? bytes : 1);
+    if (!p) throw std::bad_alloc();
+    count(static_cast<int64_t>(malloc_usable_size(p)));
+    return p;
+}
+
+void freeZeroed(void* p) {
+    countedFree(p);
+}
+
+// Pages come from PAGE_REGION_BYTES mappings. Aligned allocations from
+// malloc would waste up to the alignment in front of every page; a mapping
+// is page-aligned already and costs nothing between pages. Regions are
+// never unmapped, so a freed page is kept on a list and only its contents
+// are released (MADV_DONTNEED); it reads back as zeroes when reused.
+static const size_t PAGE_REGION_BYTES = 1 << 20;
+static std::mutex pageMutex;
+static std::vector<void*> freePages;
+
+void* allocPage() {
+    threadAllocations++;
+    std::lock_guard<std::mutex> lock(pageMutex);
+    if (freePages.empty()) {
+        void* region = mmap(nullptr, PAGE_REGION_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) throw std::bad_alloc();
+        char* base = static_cast<char*>(region);
+        for (size_t off = PAGE_REGION_BYTES; off > 0; off -= PAGE_BYTES) freePages.push_back(base + off - PAGE_BYTES);
+    }
+    void* p = freePages.back();
+    freePages.pop_back();
+    return p;
+}
+
+void freePage(void* p) {
+    if (!p) return;
+    madvise(p, PAGE_BYTES, MADV_DONTNEED);
+    std::lock_guard<std::mutex> lock(pageMutex);
+    freePages.push_back(p);
+}
+
+void countMemory(int64_t bytes) {
+    count(bytes);
+}
+
+void* operator new(size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
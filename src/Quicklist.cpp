@@ -0,0 +1,105 @@
+#include "../include/Quicklist.h"
+#include "../include/ServerConfig.h"
+
+Quicklist::Quicklist(Listpack&& first) : count(first.size()) {
+    if (!first.empty()) nodes.push_back(std::move(first));
+}
+
+bool Quicklist::hasRoom(const Listpack& node, std::string_view value) {
+    return node.empty() ||
+           node.bytes() + Listpack::entrySize(value.size()) <= ServerConfig::getInstance().listMaxListpackSize;
+}
+
+void Quicklist::pushFront(std::string_view value) {
+    if (nodes.empty() || !hasRoom(nodes.front(), value)) nodes.emplace_front();
+    nodes.front().pushFront(value);
+    count++;
+}
+
+void Quicklist::pushBack(std::string_view value) {
+    if (nodes.empty() || !hasRoom(nodes.back(), value)) nodes.emplace_back();
+    nodes.back().pushBack(value);
+    count++;
+}
+
+bool Quicklist::popFront(std::string& value) {
+    if (nodes.empty()) return false;
+    Listpack& node = nodes.front();
+    size_t pos = node.first();
+    value.assign(node.get(pos));
+    node.erase(pos);
+    if (node.empty()) nodes.pop_front();
+    count--;
+    return true;
+}
+
+bool Quicklist::popBack(std::string& value) {
+    if (nodes.empty()) return false;
+    Listpack& node = nodes.back();
+    size_t pos = node.last();
+    value.assign(node.get(pos));
+    node.erase(pos);
+    if (node.empty()) nodes.pop_back();
+    count--;
+    return true;
+}
+
+bool Quicklist::locate(long index, size_t& node, size_t& pos) const {
+    if (index < 0) index += count;
+    if (index < 0 || index >= static_cast<long>(count)) return false;
+
+    // Skip whole nodes from whichever end is nearer
+    size_t i = static_cast<size_t>(index);
+    if (i < count / 2) {
+        node = 0;
+        while (i >= nodes[node].size()) i -= nodes[node++].size();
+    } else {
+        size_t fromTail = count - 1 - i;
+        node = nodes.size() - 1;
+        while (fromTail >= nodes[node].size()) fromTail -= nodes[node--].size();
+        i = nodes[node].size() - 1 - fromTail;
+    }
+    pos = nodes[node].seek(static_cast<long>(i));
+    return true;
+}
+
+bool Quicklist::index(long index, std::string& value) const {
+    size_t node, pos;
+    if (!locate(index, node, pos)) return false;
+    value.assign(nodes[node].get(pos));
+    return true;
+}
+
+bool Quicklist::set(long index, std::string_view value) {
+    size_t node, pos;
+    if (!locate(index, node, pos)) return false;
+    nodes[node].replace(pos, value);
+    return true;
+}
+
+size_t Quicklist::remove(long limit, std::string_view value) {
+    size_t max = limit == 0 ? count : static_cast<size_t>(limit < 0 ? -limit : limit);
+    size_t removed = 0;
+
+    if (limit >= 0) {
+        for (size_t n = 0; n < nodes.size() && removed < max; ) {
+            removed += nodes[n].removeMatching(value, max - removed, false);
+            if (nodes[n].empty()) nodes.erase(nodes.begin() + n);
+            else n++;
+        }
+    } else {
+        for (size_t n = nodes.size(); n > 0 && removed < max; n--) {
+            removed += nodes[n - 1].removeMatching(value, max - removed, true);
+            if (nodes[n - 1].empty()) nodes.erase(nodes.begin() + (n - 1));
+        }
+    }
+
+    count -= removed;
+    return removed;
+}
+
+size_t Quicklist::memoryUsage() const {
+    size_t total = 0;
+    for (const auto& node : nodes) total += sizeof(Listpack) + node.allocated();
+    return total;
+}
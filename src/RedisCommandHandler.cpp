@@ -1,389 +1,739 @@
 #include "../include/RedisCommandHandler.h"
 #include "../include/RedisDatabase.h"
+#include "../include/RespParser.h"
+#include "../include/CommandTable.h"
+#include "../include/ServerConfig.h"
+#include "../include/AppendOnlyFile.h"
+#include "../include/LazyFree.h"
+#include "../include/Memory.h"
+#include "../include/ServerStats.h"
+#include "../include/SlowLog.h"
+#include "../include/LatencyMonitor.h"
 #include <iostream>
+#include <chrono>
 #include <vector>
-#include <sstream>
-#include <algorithm>
-
-
-// RESP parser
-// Sample RESP "*2\r\n$5\r\nhello\r\n$5\r\nworld\r\n"
-std::vector<std::string> parseRespCommand(const std::string& command) {
-    std::vector<std::string> tokens;
-    // std::cout << "Parsing command: \n" << command << "\n";
-    if (command.empty()) return tokens;
-    
-    // If it doesn't start with '*', fallback to splitting by whitespace.
-    if (command[0] != '*') {
-        std::istringstream iss(command);
-        std::string token;
-        while (iss >> token) {
-            tokens.push_back(token);
-        }
-        return tokens;
-    }
+#include <limits>
+#include <iterator>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <unistd.h>
 
-    size_t pos = 0;
 
-    // Expect '*' followed by number of elements
-    if (command[pos] != '*') return tokens;
-    pos++;
+RedisCommandHandler::RedisCommandHandler(){}
 
-    // crlf = carriage return (\r) + line feed (\n)
-    size_t crlf = command.find("\r\n", pos);
+std::string RedisCommandHandler::handleCommand(const std::string& command) {
+    ReplyBuffer reply;
+    executeCommand(parseRespCommand(command), reply);
+    return reply.str();
+}
 
-    // std::cout << "crlf: " << crlf << "\n";
+void RedisCommandHandler::executeCommand(const std::vector<std::string_view>& tokens, ReplyBuffer& reply,
+                                         std::string_view client) {
+    if (tokens.empty()) {
+        reply.addError("Error: Empty command");
+        return;
+    }
 
-    if (crlf == std::string::npos) return tokens;
+    const RedisCommand* command = lookupCommand(tokens[0]);
+    if (!command) {
+        reply.addError("Error: Unknown command");
+        return;
+    }
+    if (!command->checkArity(tokens.size())) {
+        reply.addError("Error: wrong number of arguments for '" + std::string(command->name) + "' command");
+        return;
+    }
 
-    int numElements = std::stoi(command.substr(pos, crlf - pos));
+    // Write commands feed the changes they make to the append only file
+    // from inside the shard locks (see RedisDatabase::Propagation)
+    std::optional<RedisDatabase::Propagation> propagation;
+    if ((command->flags & CMD_WRITE) && AppendOnlyFile::getInstance().isOpen()) propagation.emplace(lastAofOffset);
 
-    // std::cout << "Number of elements: " << numElements << "\n";
+    // Make room before adding data. Not while loading: what is replayed was
+    // accepted once, and evicting or refusing it would lose logged writes.
+    if ((command->flags & CMD_DENYOOM) && !loading && !RedisDatabase::getInstance().freeMemoryIfNeeded()) {
+        reply.addError("OOM command not allowed when used memory > 'maxmemory'");
+        return;
+    }
 
-    pos = crlf + 2;
+    size_t errors = reply.errorCount();
+    auto start = std::chrono::steady_clock::now();
+    runCommand(command, tokens, reply);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    bool failed = reply.errorCount() != errors;
+    ServerStats::local().commands[commandId(command)].record(ns, failed);
+    long long slowerThan = ServerConfig::getInstance().slowlogLogSlowerThan;
+    if (slowerThan >= 0 && ns / 1000 >= slowerThan) SlowLog::getInstance().record(tokens, ns / 1000, client);
+    LatencyMonitor::getInstance().addSampleIfNeeded((command->flags & CMD_FAST) ? "fast-command" : "command",
+                                                    ns / 1000000);
+}
 
-    for (int i = 0; i < numElements; i++) {
+void RedisCommandHandler::runCommand(const RedisCommand* command, const std::vector<std::string_view>& tokens,
+                                     ReplyBuffer& reply) {
+    try {
+        command->proc(tokens, RedisDatabase::getInstance(), reply);
+    } catch (const WrongTypeError& e) {
+        reply.addError(e.what());
+    }
+}
 
-        if (pos >= command.size() || command[pos] != '$') break; // format error
-        pos++;  // skip '$'
+// *** Handler function implementations ***
 
-        crlf = command.find("\r\n", pos);
+// Parse a command argument that must fit in an int
+static bool parseInt(std::string_view arg, int& out) {
+    long long value;
+    if (!parseInteger(arg, value) || value < std::numeric_limits<int>::min() ||
+        value > std::numeric_limits<int>::max())
+        return false;
+    out = static_cast<int>(value);
+    return true;
+}
 
-        if (crlf == std::string::npos) break;
-        int len = std::stoi(command.substr(pos, crlf - pos));
-        pos = crlf + 2;
+// Case-insensitive match of an argument against a lower-case keyword
+static bool isKeyword(std::string_view arg, std::string_view keyword) {
+    if (arg.size() != keyword.size()) return false;
+    for (size_t i = 0; i < arg.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(arg[i])) != keyword[i]) return false;
+    }
+    return true;
+}
 
-        if (pos + len > command.size()) break;
-        std::string token = command.substr(pos,len);
-        tokens.push_back(token);
-        pos += len + 2;
+// Parse a SCAN cursor: an unsigned 64-bit decimal
+static bool parseCursor(std::string_view arg, uint64_t& out) {
+    if (arg.empty() || arg.size() > 20) return false;
+    uint64_t value = 0;
+    for (char c : arg) {
+        if (c < '0' || c > '9') return false;
+        uint64_t digit = static_cast<uint64_t>(c - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) return false;
+        value = value * 10 + digit;
     }
+    out = value;
+    return true;
+}
 
-    return tokens;
+// Parse the [MATCH pattern] [COUNT n] options of SCAN/HSCAN starting at
+// tokens[first]. Replies with the error and returns false on bad input.
+static bool parseScanOptions(const std::vector<std::string_view>& tokens, size_t first,
+                             std::string_view& pattern, size_t& count, ReplyBuffer& reply) {
+    pattern = "*";
+    count = 10;
+    for (size_t i = first; i < tokens.size(); i += 2) {
+        if (i + 1 >= tokens.size()) {
+            reply.addError("Error: syntax error");
+            return false;
+        }
+        if (isKeyword(tokens[i], "match")) {
+            pattern = tokens[i + 1];
+        } else if (isKeyword(tokens[i], "count")) {
+            int n;
+            if (!parseInt(tokens[i + 1], n) || n < 1) {
+                reply.addError("Error: COUNT must be a positive integer");
+                return false;
+            }
+            count = static_cast<size_t>(n);
+        } else {
+            reply.addError("Error: syntax error");
+            return false;
+        }
+    }
+    return true;
+}
 
+// Common functions
+void handlePing(const std::vector<std::string_view>&, RedisDatabase&, ReplyBuffer& reply) {
+    reply.addSimpleString("PONG");
 }
 
-RedisCommandHandler::RedisCommandHandler(){}
+void handleEcho(const std::vector<std::string_view>& tokens, RedisDatabase&, ReplyBuffer& reply) {
+    reply.addSimpleString(tokens[1]);
+}
 
-std::string RedisCommandHandler::handleCommand(const std::string& command) {
-    auto tokens = parseRespCommand(command);
-    if (tokens.empty()) return "-Error: Empty command\r\n";
-
-    std::string cmd = tokens[0];
-    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::toupper);
-    RedisDatabase& db = RedisDatabase::getInstance();
-
-    // Common commands
-    if (cmd == "PING") {
-        return handlePing(tokens, db);
-    } else if (cmd == "ECHO") {
-        return handleEcho(tokens, db);
-    } else if (cmd == "FLUSHALL") {
-        return handleFlushAll(tokens, db);
-    } 
-    // Key/Value operations
-    else if (cmd == "SET") {
-        return handleSet(tokens, db);
-    } else if (cmd == "GET") {
-        return handleGet(tokens, db);
-    } else if (cmd == "KEYS") {
-        return handleKeys(tokens, db);
-    } else if (cmd == "TYPE") {
-        return handleType(tokens, db);
-    } else if (cmd == "DEL" || cmd == "UNLINK") {
-        return handleDel(tokens, db);
-    } else if (cmd == "EXPIRE") {
-        return handleExpire(tokens, db);
-    } else if (cmd == "RENAME") {
-        return handleRename(tokens, db);
-    }  
-    // List operations
-    else if (cmd == "LLEN") {
-        return handleLlen(tokens, db);
-    } else if (cmd == "LPUSH") {
-        return handleLpush(tokens, db);
-    } else if (cmd == "RPUSH") {
-        return handleRpush(tokens, db);
-    } else if (cmd == "LPOP") {
-        return handleLpop(tokens, db);
-    } else if (cmd == "RPOP") {
-        return handleRpop(tokens, db);
-    } else if (cmd == "LREM") {
-        return handleLrem(tokens, db);
-    } else if (cmd == "LINDEX") {
-        return handleLindex(tokens, db);
-    } else if (cmd == "LSET") {
-        return handleLset(tokens, db);
-    } else if (cmd == "HSET") {
-        return handleHset(tokens, db);
-    } else if (cmd == "HGET") {
-        return handleHget(tokens, db);
-    } else if (cmd == "HEXISTS") {
-        return handleHexists(tokens, db);
-    } else if (cmd == "HDEL") {
-        return handleHdel(tokens, db);
-    } else if (cmd == "HGETALL") {
-        return handleHgetall(tokens, db);
-    } else if (cmd == "HKEYS") {
-        return handleHkeys(tokens, db);
-    } else if (cmd == "HVALS") {
-        return handleHvals(tokens, db);
-    } else if (cmd == "HLEN") {
-        return handleHlen(tokens, db);
-    } else if (cmd == "HMSET") {
-        return handleHmset(tokens, db);
-    }
-    else {
-        return "-Error: Unknown command\r\n";
+void handleFlushAll(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    bool async = false;
+    if (tokens.size() == 2 && isKeyword(tokens[1], "async")) {
+        async = true;
+    } else if (tokens.size() > 2 || (tokens.size() == 2 && !isKeyword(tokens[1], "sync"))) {
+        reply.addError("Error: syntax error");
+        return;
     }
+    db.flushAll(async);
+    reply.addSimpleString("OK");
 }
 
-// *** Handler function implementations ***
+// Persistence
+void handleSave(const std::vector<std::string_view>&, RedisDatabase& db, ReplyBuffer& reply) {
+    if (db.saveStatus().inProgress) {
+        reply.addError("Error: Background save already in progress");
+        return;
+    }
+    if (db.dump(ServerConfig::getInstance().dbFilename))
+        reply.addSimpleString("OK");
+    else
+        reply.addError("Error: Save failed");
+}
 
-// Common functions
-std::string handlePing(const std::vector<std::string>&, RedisDatabase&) {
-    return "+PONG\r\n";
+void handleBgsave(const std::vector<std::string_view>&, RedisDatabase& db, ReplyBuffer& reply) {
+    if (db.saveStatus().inProgress) {
+        reply.addError("Error: Background save already in progress");
+        return;
+    }
+    if (db.backgroundSave(ServerConfig::getInstance().dbFilename))
+        reply.addSimpleString("Background saving started");
+    else
+        reply.addError("Error: Background save failed to start");
 }
 
-std::string handleEcho(const std::vector<std::string>& tokens, RedisDatabase&) {
-    if (tokens.size() < 2)
-        return "-Error: ECHO command requires a message\r\n";
-    return "+" + tokens[1] + "\r\n";
+void handleBgrewriteaof(const std::vector<std::string_view>&, RedisDatabase&, ReplyBuffer& reply) {
+    AppendOnlyFile& aof = AppendOnlyFile::getInstance();
+    if (!aof.isOpen()) {
+        reply.addError("Error: Append only file is not enabled");
+        return;
+    }
+    if (aof.rewriteStatus().inProgress) {
+        reply.addError("Error: Background append only file rewriting already in progress");
+        return;
+    }
+    if (aof.backgroundRewrite())
+        reply.addSimpleString("Background append only file rewriting started");
+    else
+        reply.addError("Error: Background append only file rewriting failed to start");
 }
 
-std::string handleFlushAll(const std::vector<std::string>&, RedisDatabase& db) {
-    db.flushAll();
-    return "+OK\r\n";
+void handleLastsave(const std::vector<std::string_view>&, RedisDatabase& db, ReplyBuffer& reply) {
+    reply.addInteger(db.saveStatus().lastSaveAtMs / 1000);
 }
 
 // Key/Value operations
-std::string handleSet(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: SET command requires a key and a value\r\n";
+void handleSet(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     db.set(tokens[1], tokens[2]);
-    return "+OK\r\n";
+    reply.addSimpleString("OK");
 }
 
-std::string handleGet(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: GET command requires a key\r\n";
+void handleGet(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     std::string value;
     if (db.get(tokens[1], value))
-        return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+        reply.addBulkString(std::move(value));
     else
-        return "$-1\r\n";
+        reply.addNull();
 }
 
-std::string handleKeys(const std::vector<std::string>&, RedisDatabase& db) {
-    std::vector<std::string> allKeys = db.keys();
-    std::ostringstream response;
-    response << "*" << allKeys.size() << "\r\n";
+void handleKeys(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    std::vector<std::string> allKeys = db.keys(tokens.size() > 1 ? tokens[1] : "*");
+    reply.addArrayHeader(allKeys.size());
     for (const auto& key : allKeys) {
-        response << "$" << key.size() << "\r\n" << key << "\r\n";
+        reply.addBulkString(key);
     }
-    return response.str();
 }
 
-std::string handleType(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: TYPE command requires a key\r\n";
-    return "+" + db.type(tokens[1]) + "\r\n";
+void handleScan(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    uint64_t cursor;
+    if (!parseCursor(tokens[1], cursor)) {
+        reply.addError("Error: invalid cursor");
+        return;
+    }
+    std::string_view pattern;
+    size_t count;
+    if (!parseScanOptions(tokens, 2, pattern, count, reply)) return;
+
+    std::vector<std::string> keys;
+    cursor = db.scan(cursor, count, pattern, keys);
+    reply.addArrayHeader(2);
+    reply.addBulkString(std::to_string(cursor));
+    reply.addArrayHeader(keys.size());
+    for (const auto& key : keys) {
+        reply.addBulkString(key);
+    }
 }
 
-std::string handleDel(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: DEL command requires a key\r\n";
-    bool res = db.del(tokens[1]);
-    return ":" + std::to_string(res ? 1 : 0) + "\r\n";
+void handleType(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    reply.addSimpleString(db.type(tokens[1]));
 }
 
-std::string handleExpire(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: EXPIRE command requires a key and a time in seconds";
-    int seconds = std::stoi(tokens[2]);
+void handleDel(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    long long deleted = 0;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (db.del(tokens[i])) deleted++;
+    }
+    reply.addInteger(deleted);
+}
+
+void handleUnlink(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    long long deleted = 0;
+    for (size_t i = 1; i < tokens.size(); i++) {
+        if (db.unlink(tokens[i])) deleted++;
+    }
+    reply.addInteger(deleted);
+}
+
+void handleExpire(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    int seconds;
+    if (!parseInt(tokens[2], seconds)) {
+        reply.addError("Error: Invalid expire time");
+        return;
+    }
     if (db.expire(tokens[1], seconds))
-        return "+OK\r\n";
+        reply.addSimpleString("OK");
+    else
+        reply.addError("Error: Key not found");
+}
+
+void handlePexpireat(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    long long unixMs;
+    if (!parseInteger(tokens[2], unixMs)) {
+        reply.addError("Error: Invalid expire time");
+        return;
+    }
+    if (db.expireAt(tokens[1], unixMs))
+        reply.addSimpleString("OK");
     else
-        return "-Error: Key not found\r\n";
+        reply.addError("Error: Key not found");
 }
 
-std::string handleRename(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: RENAME command requires an old key name and a new key name";
+void handleRename(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     if (db.rename(tokens[1], tokens[2]))
-        return "+OK\r\n";
+        reply.addSimpleString("OK");
     else
-        return "-Error: RENAME failed\r\n";
+        reply.addError("Error: RENAME failed");
+}
+
+void handleMemory(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    if (tokens.size() == 2 && isKeyword(tokens[1], "stats")) {
+        LazyFree& lazyFree = LazyFree::getInstance();
+        SlabAllocator::Stats slab = db.slabStats();
+        const std::pair<std::string_view, uint64_t> stats[] = {
+            {"total.allocated", usedMemory()},
+            {"slab.allocated", slab.allocatedBytes},
+            {"slab.used", slab.usedBytes},
+            {"lazyfree.pending_objects", lazyFree.pendingObjects()},
+            {"lazyfree.freed_objects", lazyFree.freedObjects()},
+        };
+        reply.addArrayHeader(std::size(stats) * 2);
+        for (const auto& stat : stats) {
+            reply.addBulkString(stat.first);
+            reply.addInteger(static_cast<long long>(stat.second));
+        }
+        return;
+    }
+    if (tokens.size() != 3 || !isKeyword(tokens[1], "usage")) {
+        reply.addError("Error: Unknown MEMORY subcommand or wrong number of arguments");
+        return;
+    }
+    long long bytes = db.memoryUsage(tokens[2]);
+    if (bytes < 0)
+        reply.addNull();
+    else
+        reply.addInteger(bytes);
+}
+
+// INFO output is a "# Section" header per section, then one field:value
+// line per field
+static void infoField(std::string& out, std::string_view name, std::string_view value) {
+    out.append(name).append(":").append(value).append("\r\n");
+}
+
+static void infoField(std::string& out, std::string_view name, uint64_t value) {
+    infoField(out, name, std::to_string(value));
+}
+
+static std::string formatFixed(double value, int digits) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return buf;
+}
+
+// 1536 -> "1.50K"
+static std::string humanBytes(uint64_t bytes) {
+    static const char units[] = "BKMGTP";
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < sizeof(units) - 1) {
+        value /= 1024;
+        unit++;
+    }
+    return unit == 0 ? std::to_string(bytes) + "B" : formatFixed(value, 2) + units[unit];
+}
+
+// Resident set size from /proc; 0 where it is not available
+static uint64_t residentMemory() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    if (!(statm >> size >> resident)) return 0;
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+static std::string okOrErr(bool ok) { return ok ? "ok" : "err"; }
+
+static void infoServer(std::string& out, RedisDatabase&, const ServerStats::Totals&) {
+    ServerConfig& config = ServerConfig::getInstance();
+    int64_t uptime = ServerStats::getInstance().uptimeMs() / 1000;
+    infoField(out, "process_id", static_cast<uint64_t>(getpid()));
+    infoField(out, "tcp_port", static_cast<uint64_t>(config.port));
+    infoField(out, "uptime_in_seconds", static_cast<uint64_t>(uptime));
+    infoField(out, "uptime_in_days", static_cast<uint64_t>(uptime / 86400));
+    infoField(out, "io_threads", static_cast<uint64_t>(config.ioThreads));
+    infoField(out, "keyspace_shards", RedisDatabase::SHARD_COUNT);
+}
+
+static void infoClients(std::string& out, RedisDatabase&, const ServerStats::Totals& totals) {
+    infoField(out, "connected_clients", totals.connectedClients);
+}
+
+static void infoMemory(std::string& out, RedisDatabase& db, const ServerStats::Totals&) {
+    ServerConfig& config = ServerConfig::getInstance();
+    LazyFree& lazyFree = LazyFree::getInstance();
+    uint64_t used = usedMemory();
+    uint64_t rss = residentMemory();
+    uint64_t peak = ServerStats::getInstance().peakMemory();
+    infoField(out, "used_memory", used);
+    infoField(out, "used_memory_human", humanBytes(used));
+    infoField(out, "used_memory_rss", rss);
+    infoField(out, "used_memory_rss_human", humanBytes(rss));
+    infoField(out, "used_memory_peak", peak);
+    infoField(out, "used_memory_peak_human", humanBytes(peak));
+    infoField(out, "maxmemory", config.maxmemory);
+    infoField(out, "maxmemory_human", humanBytes(config.maxmemory));
+    infoField(out, "maxmemory_policy", config.maxmemoryPolicy);
+    infoField(out, "mem_fragmentation_ratio", formatFixed(used ? static_cast<double>(rss) / used : 0, 2));
+    SlabAllocator::Stats slab = db.slabStats();
+    infoField(out, "slab_allocated_bytes", slab.allocatedBytes);
+    infoField(out, "slab_used_bytes", slab.usedBytes);
+    infoField(out, "slab_fragmentation_ratio",
+              formatFixed(slab.usedBytes ? static_cast<double>(slab.allocatedBytes) / slab.usedBytes : 0, 2));
+    infoField(out, "active_defrag_running", db.activeDefragRunning() ? 1 : 0);
+    infoField(out, "active_defrag_hits", db.defragHitCount());
+    infoField(out, "lazyfree_pending_objects", lazyFree.pendingObjects());
+    infoField(out, "lazyfreed_objects", lazyFree.freedObjects());
+}
+
+static void infoPersistence(std::string& out, RedisDatabase& db, const ServerStats::Totals&) {
+    RedisDatabase::SaveStatus save = db.saveStatus();
+    RedisDatabase::LoadStatus load = db.loadStatus();
+    AppendOnlyFile& aof = AppendOnlyFile::getInstance();
+    AppendOnlyFile::RewriteStatus rewrite = aof.rewriteStatus();
+    int64_t now = unixNowMs();
+    infoField(out, "loading_keys_loaded", load.keys);
+    infoField(out, "loading_time_ms", std::to_string(load.durationMs));
+    infoField(out, "rdb_bgsave_in_progress", save.inProgress ? 1 : 0);
+    infoField(out, "rdb_last_save_time", static_cast<uint64_t>(save.lastSaveAtMs / 1000));
+    infoField(out, "rdb_seconds_since_last_save", static_cast<uint64_t>((now - save.lastSaveAtMs) / 1000));
+    infoField(out, "rdb_last_bgsave_status", okOrErr(save.lastBgsaveOk));
+    infoField(out, "rdb_last_bgsave_time_sec",
+              std::to_string(save.lastBgsaveDurationMs < 0 ? -1 : save.lastBgsaveDurationMs / 1000));
+    infoField(out, "rdb_current_bgsave_time_sec",
+              std::to_string(save.inProgress ? (now - save.startedAtMs) / 1000 : -1));
+    infoField(out, "rdb_current_bgsave_keys_saved", save.keysSaved);
+    infoField(out, "rdb_current_bgsave_keys_total", save.keysTotal);
+    infoField(out, "aof_enabled", aof.isOpen() ? 1 : 0);
+    infoField(out, "aof_rewrite_in_progress", rewrite.inProgress ? 1 : 0);
+    infoField(out, "aof_last_bgrewrite_status", okOrErr(rewrite.lastOk));
+    infoField(out, "aof_last_rewrite_time_sec",
+              std::to_string(rewrite.lastDurationMs < 0 ? -1 : rewrite.lastDurationMs / 1000));
+    if (aof.isOpen()) {
+        infoField(out, "aof_current_size", rewrite.size);
+        infoField(out, "aof_base_size", rewrite.baseSize);
+    }
+}
+
+static void infoStats(std::string& out, RedisDatabase& db, const ServerStats::Totals& totals) {
+    infoField(out, "total_connections_received", totals.connectionsReceived);
+    infoField(out, "total_commands_processed", totals.commandsProcessed);
+    infoField(out, "instantaneous_ops_per_sec",
+              static_cast<uint64_t>(ServerStats::getInstance().instantaneousOpsPerSec() + 0.5));
+    infoField(out, "total_net_input_bytes", totals.netInputBytes);
+    infoField(out, "total_net_output_bytes", totals.netOutputBytes);
+    infoField(out, "expired_keys", db.expiredKeyCount());
+    infoField(out, "evicted_keys", db.evictedKeyCount());
+    infoField(out, "keyspace_hits", totals.keyspaceHits);
+    infoField(out, "keyspace_misses", totals.keyspaceMisses);
+}
+
+static void infoKeyspace(std::string& out, RedisDatabase& db, const ServerStats::Totals&) {
+    RedisDatabase::KeyspaceStats stats = db.keyspaceStats();
+    if (stats.keys == 0) return;
+    infoField(out, "db0", "keys=" + std::to_string(stats.keys) + ",expires=" + std::to_string(stats.volatileKeys) +
+              ",strings=" + std::to_string(stats.strings) + ",lists=" + std::to_string(stats.lists) +
+              ",hashes=" + std::to_string(stats.hashes));
+}
+
+static void infoCommandstats(std::string& out, RedisDatabase&, const ServerStats::Totals& totals) {
+    for (size_t id = 0; id < totals.commands.size(); id++) {
+        const ServerStats::CommandTotals& command = totals.commands[id];
+        if (command.calls == 0) continue;
+        double usec = command.totalNs / 1000.0;
+        infoField(out, "cmdstat_" + std::string(commandById(id).name),
+                  "calls=" + std::to_string(command.calls) +
+                  ",usec=" + std::to_string(static_cast<uint64_t>(usec)) +
+                  ",usec_per_call=" + formatFixed(usec / command.calls, 2) +
+                  ",failed_calls=" + std::to_string(command.failedCalls));
+    }
+}
+
+static void infoLatencystats(std::string& out, RedisDatabase&, const ServerStats::Totals& totals) {
+    for (size_t id = 0; id < totals.commands.size(); id++) {
+        const ServerStats::CommandTotals& command = totals.commands[id];
+        if (command.calls == 0) continue;
+        infoField(out, "latency_percentiles_usec_" + std::string(commandById(id).name),
+                  "p50=" + formatFixed(command.percentile(50) / 1000.0, 3) +
+                  ",p99=" + formatFixed(command.percentile(99) / 1000.0, 3) +
+                  ",p99.9=" + formatFixed(command.percentile(99.9) / 1000.0, 3));
+    }
+}
+
+struct InfoSection {
+    std::string_view name;
+    std::string_view title;
+    bool inDefault;     // Part of a plain INFO
+    void (*write)(std::string& out, RedisDatabase& db, const ServerStats::Totals& totals);
+};
+
+static const InfoSection infoSections[] = {
+    {"server",       "Server",       true,  infoServer},
+    {"clients",      "Clients",      true,  infoClients},
+    {"memory",       "Memory",       true,  infoMemory},
+    {"persistence",  "Persistence",  true,  infoPersistence},
+    {"stats",        "Stats",        true,  infoStats},
+    {"keyspace",     "Keyspace",     true,  infoKeyspace},
+    {"commandstats", "Commandstats", false, infoCommandstats},
+    {"latencystats", "Latencystats", false, infoLatencystats},
+};
+
+void handleInfo(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    // Section names, "default", or "all"/"everything" for every section
+    auto wanted = [&](const InfoSection& section) {
+        if (tokens.size() == 1) return section.inDefault;
+        for (size_t i = 1; i < tokens.size(); i++) {
+            if (isKeyword(tokens[i], section.name) || isKeyword(tokens[i], "all") ||
+                isKeyword(tokens[i], "everything") || (section.inDefault && isKeyword(tokens[i], "default")))
+                return true;
+        }
+        return false;
+    };
+
+    ServerStats::Totals totals = ServerStats::getInstance().collect();
+    std::string out;
+    for (const InfoSection& section : infoSections) {
+        if (!wanted(section)) continue;
+        if (!out.empty()) out += "\r\n";
+        out.append("# ").append(section.title).append("\r\n");
+        section.write(out, db, totals);
+    }
+    reply.addBulkString(std::move(out));
+}
+
+void handleSlowlog(const std::vector<std::string_view>& tokens, RedisDatabase&, ReplyBuffer& reply) {
+    SlowLog& slowLog = SlowLog::getInstance();
+    if (isKeyword(tokens[1], "get") && tokens.size() <= 3) {
+        // Ten entries by default; a negative count returns them all
+        size_t count = 10;
+        if (tokens.size() == 3) {
+            long long n;
+            if (!parseInteger(tokens[2], n)) {
+                reply.addError("Error: count is not an integer");
+                return;
+            }
+            count = n < 0 ? SIZE_MAX : static_cast<size_t>(n);
+        }
+        std::vector<SlowLogEntry> entries = slowLog.get(count);
+        reply.addArrayHeader(entries.size());
+        for (const SlowLogEntry& entry : entries) {
+            reply.addArrayHeader(6);
+            reply.addInteger(static_cast<long long>(entry.id));
+            reply.addInteger(entry.time);
+            reply.addInteger(static_cast<long long>(entry.durationUs));
+            reply.addArrayHeader(entry.args.size());
+            for (const std::string& arg : entry.args) reply.addBulkString(arg);
+            reply.addBulkString(entry.client);
+            reply.addBulkString(std::string_view());    // Client name; connections have none
+        }
+    } else if (isKeyword(tokens[1], "len") && tokens.size() == 2) {
+        reply.addInteger(static_cast<long long>(slowLog.length()));
+    } else if (isKeyword(tokens[1], "reset") && tokens.size() == 2) {
+        slowLog.reset();
+        reply.addSimpleString("OK");
+    } else {
+        reply.addError("Error: Unknown SLOWLOG subcommand or wrong number of arguments");
+    }
+}
+
+void handleLatency(const std::vector<std::string_view>& tokens, RedisDatabase&, ReplyBuffer& reply) {
+    LatencyMonitor& monitor = LatencyMonitor::getInstance();
+    if (isKeyword(tokens[1], "latest") && tokens.size() == 2) {
+        std::vector<LatencyMonitor::EventStats> events = monitor.latest();
+        reply.addArrayHeader(events.size());
+        for (const auto& event : events) {
+            reply.addArrayHeader(4);
+            reply.addBulkString(event.name);
+            reply.addInteger(event.latest.time);
+            reply.addInteger(static_cast<long long>(event.latest.ms));
+            reply.addInteger(static_cast<long long>(event.maxMs));
+        }
+    } else if (isKeyword(tokens[1], "history") && tokens.size() == 3) {
+        std::vector<LatencyMonitor::Sample> samples = monitor.history(tokens[2]);
+        reply.addArrayHeader(samples.size());
+        for (const auto& sample : samples) {
+            reply.addArrayHeader(2);
+            reply.addInteger(sample.time);
+            reply.addInteger(static_cast<long long>(sample.ms));
+        }
+    } else if (isKeyword(tokens[1], "reset")) {
+        std::vector<std::string_view> events(tokens.begin() + 2, tokens.end());
+        reply.addInteger(static_cast<long long>(monitor.reset(events)));
+    } else {
+        reply.addError("Error: Unknown LATENCY subcommand or wrong number of arguments");
+    }
 }
 
 // List Operations
-std::string handleLlen(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: LLEN command requires key\r\n";
-    ssize_t len = db.llen(tokens[1]);
-    return ":" + std::to_string(len) + "\r\n";
-}
-
-std::string handleLpush(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: LPUSH command requires key and at least one value\r\n";
-    std::vector<std::string> values(tokens.begin() + 2, tokens.end());
-    db.lpush(tokens[1], values);
-    ssize_t len = db.llen(tokens[1]);
-    return ":" + std::to_string(len) + "\r\n";
-}
-
-std::string handleRpush(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: RPUSH command requires key and at least one value\r\n";
-    std::vector<std::string> values(tokens.begin() + 2, tokens.end());
-    db.rpush(tokens[1], values);
-    ssize_t len = db.llen(tokens[1]);
-    return ":" + std::to_string(len) + "\r\n";
-}
-
-std::string handleLpop(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: LPOP command requires key\r\n";
+void handleLlen(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    reply.addInteger(db.llen(tokens[1]));
+}
+
+void handleLpush(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    reply.addInteger(db.lpush(tokens[1], &tokens[2], tokens.size() - 2));
+}
+
+void handleRpush(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    reply.addInteger(db.rpush(tokens[1], &tokens[2], tokens.size() - 2));
+}
+
+void handleLpop(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     std::string val;
     if (db.lpop(tokens[1], val))
-        return "$" + std::to_string(val.size()) + "\r\n" + val + "\r\n";
-    return "$-1\r\n";
+        reply.addBulkString(std::move(val));
+    else
+        reply.addNull();
 }
  
-std::string handleRpop(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: RPOP command requires key\r\n";
+void handleRpop(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     std::string val;
     if (db.rpop(tokens[1], val))
-        return "$" + std::to_string(val.size()) + "\r\n" + val + "\r\n";
-    return "$-1\r\n";
+        reply.addBulkString(std::move(val));
+    else
+        reply.addNull();
 }
 
-std::string handleLrem(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 4)
-        return "-Error: LREM command requires key, count, and value\r\n";
-    try {
-        int count = std::stoi(tokens[2]);
-        int removed = db.lrem(tokens[1], count, tokens[3]);
-        return ":" + std::to_string(removed) + "\r\n";
-    } catch (const std::exception&) {
-        return "-Error: Invalid count\r\n";
+void handleLrem(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    int count;
+    if (!parseInt(tokens[2], count)) {
+        reply.addError("Error: Invalid count");
+        return;
     }
+    reply.addInteger(db.lrem(tokens[1], count, tokens[3]));
 }
 
-std::string handleLindex(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: LINDEX command requires key and index\r\n";
-    try {
-        int index = std::stoi(tokens[2]);
-        std::string value;
-        if (db.lindex(tokens[1], index, value))
-            return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
-        else
-            return "$-1\r\n";
-    } catch (const std::exception&) {
-        return "-Error: Invalid index\r\n";
+void handleLindex(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    int index;
+    if (!parseInt(tokens[2], index)) {
+        reply.addError("Error: Invalid index");
+        return;
     }
+    std::string value;
+    if (db.lindex(tokens[1], index, value))
+        reply.addBulkString(std::move(value));
+    else
+        reply.addNull();
 }
 
-std::string handleLset(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 4)
-        return "-Error: LSET command requires key, index, and value\r\n";
-    try {
-        int index = std::stoi(tokens[2]);
-        if (db.lset(tokens[1], index, tokens[3]))
-            return "+OK\r\n";
-        else
-            return "-Error: Index out or range\r\n";
-    } catch (const std::exception&) {
-        return "-Error: Invalid index\r\n";
+void handleLset(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    int index;
+    if (!parseInt(tokens[2], index)) {
+        reply.addError("Error: Invalid index");
+        return;
     }
+    if (db.lset(tokens[1], index, tokens[3]))
+        reply.addSimpleString("OK");
+    else
+        reply.addError("Error: Index out or range");
 }
 
 // Hash Operations
-std::string handleHset(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 4)
-        return "-Error: HSET requires key, field, and value\r\n";
-    int updated = db.hset(tokens[1], tokens[2], tokens[3]);
-    return ":" + std::to_string(updated) + "\r\n";
+void handleHset(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    if ((tokens.size() - 2) % 2 != 0) {
+        reply.addError("Error: HSET requires key and one or more field value pairs");
+        return;
+    }
+    reply.addInteger(db.hmset(tokens[1], &tokens[2], tokens.size() - 2));
 }
 
-std::string handleHget(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: HGET requires key and field\r\n";
+void handleHget(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     std::string value;
     if (db.hget(tokens[1], tokens[2], value))
-        return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+        reply.addBulkString(std::move(value));
     else
-        return "$-1\r\n";
+        reply.addNull();
 }
 
-std::string handleHexists(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: HEXISTS requires key and field\r\n";
+void handleHexists(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     bool exists = db.hexists(tokens[1], tokens[2]);
-    return ":" + std::to_string(exists ? 1 : 0) + "\r\n";
+    reply.addInteger(exists ? 1 : 0);
 }
 
-std::string handleHdel(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 3)
-        return "-Error: HDEL requires key and field\r\n";
-    int removed = db.hdel(tokens[1], tokens[2]);
-    return ":" + std::to_string(removed) + "\r\n";
+void handleHdel(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    long long removed = 0;
+    for (size_t i = 2; i < tokens.size(); i++) {
+        removed += db.hdel(tokens[1], tokens[i]);
+    }
+    reply.addInteger(removed);
 }
 
-std::string handleHgetall(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: HGETALL requires key\r\n";
+void handleHscan(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    uint64_t cursor;
+    if (!parseCursor(tokens[2], cursor)) {
+        reply.addError("Error: invalid cursor");
+        return;
+    }
+    std::string_view pattern;
+    size_t count;
+    if (!parseScanOptions(tokens, 3, pattern, count, reply)) return;
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    cursor = db.hscan(tokens[1], cursor, count, pattern, pairs);
+    reply.addArrayHeader(2);
+    reply.addBulkString(std::to_string(cursor));
+    reply.addArrayHeader(pairs.size() * 2);
+    for (const auto& kv : pairs) {
+        reply.addBulkString(kv.first);
+        reply.addBulkString(kv.second);
+    }
+}
+
+void handleHgetall(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     auto pairs = db.hgetall(tokens[1]);
-    std::ostringstream resp;
-    resp << "*" << pairs.size() * 2 << "\r\n";
+    reply.addArrayHeader(pairs.size() * 2);
     for (const auto& kv : pairs) {
-        resp << "$" << kv.first.size() << "\r\n" << kv.first << "\r\n";
-        resp << "$" << kv.second.size() << "\r\n" << kv.second << "\r\n";
+        reply.addBulkString(kv.first);
+        reply.addBulkString(kv.second);
     }
-    return resp.str();
 }
 
-std::string handleHkeys(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: HKEYS requires key\r\n";
+void handleHkeys(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     auto keys = db.hkeys(tokens[1]);
-    std::ostringstream resp;
-    resp << "*" << keys.size() << "\r\n";
+    reply.addArrayHeader(keys.size());
     for (const auto& k : keys) {
-        resp << "$" << k.size() << "\r\n" << k << "\r\n";
+        reply.addBulkString(k);
     }
-    return resp.str();
 }
 
-std::string handleHvals(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: HVALS requires key\r\n";
+void handleHvals(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
     auto vals = db.hvals(tokens[1]);
-    std::ostringstream resp;
-    resp << "*" << vals.size() << "\r\n";
-    for (const auto& v : vals) {
-        resp << "$" << v.size() << "\r\n" << v << "\r\n";
+    reply.addArrayHeader(vals.size());
+    for (auto& v : vals) {
+        reply.addBulkString(std::move(v));
     }
-    return resp.str();
 }
 
-std::string handleHlen(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 2)
-        return "-Error: HLEN requires key\r\n";
-    int len = db.hlen(tokens[1]);
-    return ":" + std::to_string(len) + "\r\n";
+void handleHlen(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    reply.addInteger(db.hlen(tokens[1]));
 }
 
-std::string handleHmset(const std::vector<std::string>& tokens, RedisDatabase& db) {
-    if (tokens.size() < 4 || (tokens.size() - 2) % 2 != 0)
-        return "-Error: HMSET requires key and one or more field value pairs\r\n";
-    std::vector<std::pair<std::string, std::string>> field_values;
-    for (size_t i = 2; i + 1 < tokens.size(); i += 2) {
-        field_values.emplace_back(tokens[i], tokens[i + 1]);
+void handleHmset(const std::vector<std::string_view>& tokens, RedisDatabase& db, ReplyBuffer& reply) {
+    if ((tokens.size() - 2) % 2 != 0) {
+        reply.addError("Error: HMSET requires key and one or more field value pairs");
+        return;
     }
-    db.hmset(tokens[1], field_values);
-    return "+OK\r\n";
-}
\ No newline at end of file
+    db.hmset(tokens[1], &tokens[2], tokens.size() - 2);
+    reply.addSimpleString("OK");
+}
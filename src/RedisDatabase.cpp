@@ -1,61 +1,652 @@
 #include "../include/RedisDatabase.h"
+#include "../include/Snapshot.h"
+#include "../include/ServerConfig.h"
+#include "../include/AppendOnlyFile.h"
+#include "../include/Eviction.h"
+#include "../include/Memory.h"
+#include "../include/GlobMatch.h"
+#include "../include/LazyFree.h"
+#include "../include/ServerStats.h"
+#include "../include/LatencyMonitor.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <iterator>
+#include <functional>
+#include <random>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 
 RedisDatabase& RedisDatabase::getInstance() {
     static RedisDatabase instance;
     return instance;
 }
 
+RedisDatabase::RedisDatabase() {
+    // LASTSAVE reports the startup time until the first save
+    status.lastSaveAtMs = unixNowMs();
+}
+
+using ReadLock = std::shared_lock<std::shared_mutex>;
+using WriteLock = std::unique_lock<std::shared_mutex>;
+
+// Log offset of the Propagation active on this thread, if any
+static thread_local uint64_t* propagateOffset = nullptr;
+
+// Set while the append only file is replayed (see setLoading)
+static std::atomic<bool> loadingLog{false};
+
+void RedisDatabase::setLoading(bool on) {
+    loadingLog.store(on, std::memory_order_relaxed);
+}
+
+// Whether a command should treat `entry` as gone. Never during replay: the
+// log was written when the key still existed, so later entries may need it.
+static bool expiredFor(const KeyEntry& entry, int64_t now) {
+    return !loadingLog.load(std::memory_order_relaxed) && entry.isExpired(now);
+}
+
+RedisDatabase::Propagation::Propagation(uint64_t& offset) : previous(propagateOffset) {
+    propagateOffset = &offset;
+}
+
+RedisDatabase::Propagation::~Propagation() {
+    propagateOffset = previous;
+}
+
+// Feed a change to the append only file if this thread is propagating
+// (lock of the changed shard held)
+static void propagate(const std::string_view* args, size_t count) {
+    if (propagateOffset) *propagateOffset = AppendOnlyFile::getInstance().feed(args, count);
+}
+
+static void propagate(std::initializer_list<std::string_view> args) {
+    propagate(args.begin(), args.size());
+}
+
+// A command with `count` arguments after `name key`
+static void propagate(std::string_view name, std::string_view key, const std::string_view* args, size_t count) {
+    if (!propagateOffset) return;
+    std::vector<std::string_view> command{name, key};
+    command.insert(command.end(), args, args + count);
+    propagate(command.data(), command.size());
+}
+
+size_t RedisDatabase::shardIndex(uint64_t hash) {
+    // The tables index slots with the low bits; pick the shard with the high
+    // bits so the two choices are independent.
+    return (hash >> 32) % SHARD_COUNT;
+}
+
+KeyEntry* RedisDatabase::Shard::findLive(std::string_view key, uint64_t hash) const {
+    ThreadStats& stats = ServerStats::local();
+    KeyEntry* entry = table.find(key, hash);
+    int64_t now = steadyNowMs();
+    if (!entry || expiredFor(*entry, now)) {
+        stats.keyspaceMisses.add();
+        return nullptr;
+    }
+    stats.keyspaceHits.add();
+    touchEntry(*entry, now);
+    return entry;
+}
+
+KeyEntry* RedisDatabase::Shard::findForWrite(std::string_view key, uint64_t hash) {
+    KeyEntry* entry = table.find(key, hash);
+    if (!entry) return nullptr;
+    int64_t now = steadyNowMs();
+    if (expiredFor(*entry, now)) {
+        erase(key, hash);
+        expired.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    touchEntry(*entry, now);
+    return entry;
+}
+
+void RedisDatabase::Shard::scheduleExpiry(const KeyEntry& entry, uint64_t hash) {
+    // Stale items accumulate when TTLs are overwritten or keys deleted early.
+    // Once they dominate the heap, rebuild it from the live entries.
+    if (expires.size() > table.size() * 2 + 1024) {
+        expires.clear();
+        table.forEach([&](const KeyEntry& e) {
+            if (e.expireAt != 0 && &e != &entry)
+                expires.push_back(ExpireItem{e.expireAt, hashKey(e.key()), std::string(e.key())});
+        });
+        std::make_heap(expires.begin(), expires.end(), std::greater<ExpireItem>());
+    }
+    expires.push_back(ExpireItem{entry.expireAt, hash, std::string(entry.key())});
+    std::push_heap(expires.begin(), expires.end(), std::greater<ExpireItem>());
+}
+
+void RedisDatabase::Shard::count(const KeyEntry& entry, int delta) {
+    typeCounts[static_cast<size_t>(entry.type())] += delta;
+    if (entry.expireAt != 0) volatileKeys += delta;
+}
+
+KeyEntry* RedisDatabase::Shard::insert(std::string_view key, uint64_t hash, KeyValue&& value) {
+    KeyEntry* entry = table.insert(key, hash, std::move(value));
+    count(*entry, 1);
+    return entry;
+}
+
+KeyEntryPtr RedisDatabase::Shard::remove(std::string_view key, uint64_t hash) {
+    KeyEntryPtr entry = table.remove(key, hash);
+    if (entry) count(*entry, -1);
+    return entry;
+}
+
+void RedisDatabase::Shard::setValue(KeyEntry& entry, KeyValue&& value) {
+    count(entry, -1);
+    entry.setValue(std::move(value));
+    count(entry, 1);
+}
+
+void RedisDatabase::Shard::setExpireAt(KeyEntry& entry, uint64_t hash, int64_t deadline) {
+    if ((entry.expireAt != 0) != (deadline != 0)) volatileKeys += deadline != 0 ? 1 : -1;
+    entry.expireAt = deadline;
+    if (deadline != 0) scheduleExpiry(entry, hash);
+}
+
+void RedisDatabase::Shard::clear() {
+    table.clear();
+    expires.clear();
+    typeCounts.fill(0);
+    volatileKeys = 0;
+}
+
+size_t RedisDatabase::Shard::expireDue(int64_t now, size_t max, bool& more) {
+    size_t removed = 0;
+    more = false;
+    while (!expires.empty() && expires.front().deadline < now) {
+        if (removed == max) {
+            more = true;
+            break;
+        }
+        std::pop_heap(expires.begin(), expires.end(), std::greater<ExpireItem>());
+        ExpireItem item = std::move(expires.back());
+        expires.pop_back();
+
+        KeyEntry* entry = table.find(item.key, item.hash);
+        if (entry && entry->expireAt == item.deadline) {
+            erase(item.key, item.hash);
+            removed++;
+        }
+    }
+    expired.fetch_add(removed, std::memory_order_relaxed);
+    return removed;
+}
+
+size_t RedisDatabase::activeExpireCycle(int64_t budgetMs) {
+    // Visit the shards in turn, removing at most EXPIRE_BATCH keys per lock
+    // hold so a burst of expiring keys never blocks one shard for long, and
+    // keep sweeping while keys are due and the time budget lasts.
+    static const size_t EXPIRE_BATCH = 64;
+    int64_t start = steadyNowMs();
+    size_t removed = 0;
+    bool pending = true;
+    {
+        LatencyTimer stall("expire-cycle");
+        while (pending) {
+            pending = false;
+            for (auto& shard : shards) {
+                bool more;
+                {
+                    WriteLock lock(shard.mtx);
+                    removed += shard.expireDue(steadyNowMs(), EXPIRE_BATCH, more);
+                }
+                pending = pending || more;
+            }
+            if (steadyNowMs() - start >= budgetMs) break;
+        }
+    }
+
+    // Also move tables that are mid-resize along, so a shard that stops
+    // getting writes does not keep two slot arrays around
+    static const size_t REHASH_BATCH = 1024;
+    LatencyTimer rehash("rehash");
+    for (auto& shard : shards) {
+        if (steadyNowMs() - start >= budgetMs) break;
+        WriteLock lock(shard.mtx);
+        if (shard.table.isRehashing()) shard.table.rehash(REHASH_BATCH);
+    }
+    return removed;
+}
+
+size_t RedisDatabase::activeDefragCycle(int64_t budgetMs) {
+    // A pass walks the shards in turn, moving at most DEFRAG_BATCH slots'
+    // worth of entries per lock hold, and picks up where the last call
+    // stopped until every shard has been visited once
+    static const size_t DEFRAG_BATCH = 256;
+    const ServerConfig& config = ServerConfig::getInstance();
+    if (!defragRunning.load(std::memory_order_relaxed)) {
+        SlabAllocator::Stats stats = slabStats();
+        uint64_t waste = stats.allocatedBytes - stats.usedBytes;
+        if (waste < config.activeDefragIgnoreBytes ||
+            waste * 100 < stats.allocatedBytes * config.activeDefragThresholdLower) return 0;
+        defragRunning.store(true, std::memory_order_relaxed);
+    }
+
+    LatencyTimer stall("active-defrag-cycle");
+    int64_t start = steadyNowMs();
+    size_t moved = 0;
+    while (steadyNowMs() - start < budgetMs) {
+        Shard& shard = shards[defragShard];
+        {
+            WriteLock lock(shard.mtx);
+            moved += shard.table.defrag(defragCursor, DEFRAG_BATCH);
+        }
+        if (defragCursor != 0) continue;
+        if (++defragShard == SHARD_COUNT) {
+            defragShard = 0;
+            defragRunning.store(false, std::memory_order_relaxed);
+            break;
+        }
+    }
+    defragHits.fetch_add(moved, std::memory_order_relaxed);
+    return moved;
+}
+
+SlabAllocator::Stats RedisDatabase::slabStats() {
+    SlabAllocator::Stats total;
+    for (auto& shard : shards) {
+        // The lock keeps FLUSHALL ASYNC from swapping the table underneath
+        ReadLock lock(shard.mtx);
+        SlabAllocator::Stats stats = shard.table.slabStats();
+        total.slabs += stats.slabs;
+        total.allocatedBytes += stats.allocatedBytes;
+        total.usedBytes += stats.usedBytes;
+    }
+    return total;
+}
+
+uint64_t RedisDatabase::expiredKeyCount() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) total += shard.expired.load(std::memory_order_relaxed);
+    return total;
+}
+
+RedisDatabase::KeyspaceStats RedisDatabase::keyspaceStats() {
+    KeyspaceStats stats;
+    for (auto& shard : shards) {
+        ReadLock lock(shard.mtx);
+        stats.strings += shard.typeCounts[static_cast<size_t>(ObjectType::String)];
+        stats.lists += shard.typeCounts[static_cast<size_t>(ObjectType::List)];
+        stats.hashes += shard.typeCounts[static_cast<size_t>(ObjectType::Hash)];
+        stats.volatileKeys += shard.volatileKeys;
+    }
+    stats.keys = stats.strings + stats.lists + stats.hashes;
+    return stats;
+}
+
+// Typed access to an entry's value; a command on the wrong type fails.
+static std::string_view stringOf(const KeyEntry& entry) {
+    if (entry.type() != ObjectType::String) throw WrongTypeError();
+    return entry.str();
+}
+
+static RedisList& listOf(KeyEntry& entry) {
+    if (entry.type() != ObjectType::List) throw WrongTypeError();
+    return entry.list();
+}
+
+static RedisHash& hashOf(KeyEntry& entry) {
+    if (entry.type() != ObjectType::Hash) throw WrongTypeError();
+    return entry.hash();
+}
+
 bool RedisDatabase::dump(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(mtx); // Lock the mutex for thread safety
+    // A foreground save supersedes a background one; make sure the child
+    // cannot rename an older image over this one afterwards.
+    {
+        std::unique_lock<std::mutex> lock(saveMtx);
+        if (saveChild != -1) {
+            kill(saveChild, SIGKILL);
+            saveDone.wait(lock, [this] { return saveChild == -1; });
+        }
+    }
+
+    // Lock every shard, in index order, for a consistent snapshot
+    LatencyTimer stall("snapshot-stall");
+    std::vector<ReadLock> locks;
+    for (auto& shard : shards) locks.emplace_back(shard.mtx);
+
     std::cout << "Dumping database to " << filename << "\n";
-    std::ofstream ofs(filename, std::ios::binary);
-    
-    if (!ofs) {
-        std::cerr << "Error opening file for writing: " << filename << "\n";
-        return false;
+    if (!writeSnapshot(filename)) return false;
+
+    std::lock_guard<std::mutex> lock(saveMtx);
+    status.lastSaveAtMs = unixNowMs();
+    return true;
+}
+
+static bool writeAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += n;
     }
+    return true;
+}
+
+// Temporary file that process `pid` writes `filename` through
+static std::string tempFileName(const std::string& filename, pid_t pid) {
+    return filename + ".tmp-" + std::to_string(pid);
+}
 
-    for (const auto& kv : kv_store) {
-        ofs << "K " << kv.first << " " << kv.second << "\n";
+// Write a file through `body` next to the target and rename it into place
+// on success, so a crash or a full disk mid-write never leaves a truncated
+// file behind.
+static bool writeFileAtomically(const std::string& filename, const std::function<bool(int)>& body) {
+    std::string tmpname = tempFileName(filename, getpid());
+    int fd = open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error opening file for writing: " << tmpname << "\n";
+        return false;
+    }
+    bool ok = body(fd);
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok && ::rename(tmpname.c_str(), filename.c_str()) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Error writing " << filename << ": " << strerror(errno) << "\n";
+        unlink(tmpname.c_str());
     }
+    return ok;
+}
+
+bool RedisDatabase::writeSnapshot(const std::string& filename, std::atomic<uint64_t>* progress) const {
+    return writeFileAtomically(filename, [&](int fd) {
+        // One section per shard. Deadlines are stored as wall-clock time so
+        // they survive a restart; keys that have already expired are skipped.
+        int64_t steadyNow = steadyNowMs(), unixNow = unixNowMs();
+        bool compress = ServerConfig::getInstance().snapshotCompression;
+        SnapshotHeader header;
+        header.sections = SHARD_COUNT;
+        header.savedAtMs = unixNow;
+        std::string out;
+        encodeSnapshotHeader(out, header);
+        bool ok = writeAll(fd, out);
 
-    for (const auto& kv : list_store) {
-        ofs << "L " << kv.first << " ";
-        for (const auto& item : kv.second) {
-            ofs << " " << item;
+        std::string payload;
+        for (const auto& shard : shards) {
+            if (!ok) break;
+            payload.clear();
+            uint32_t entries = 0;
+            shard.table.forEach([&](const KeyEntry& entry) {
+                if (entry.isExpired(steadyNow)) return;
+                int64_t expireAt = entry.expireAt ? entry.expireAt - steadyNow + unixNow : 0;
+                encodeSnapshotEntry(payload, entry, expireAt, compress);
+                entries++;
+            });
+            out.clear();
+            encodeSnapshotSectionHeader(out, entries, payload);
+            ok = writeAll(fd, out) && writeAll(fd, payload);
+            if (progress) progress->fetch_add(entries, std::memory_order_relaxed);
         }
-        ofs << "\n";
+        return ok;
+    });
+}
+
+bool RedisDatabase::writeAofEntries(int fd) const {
+    int64_t steadyNow = steadyNowMs(), unixNow = unixNowMs();
+    std::string out;
+    for (const auto& shard : shards) {
+        out.clear();
+        shard.table.forEach([&](const KeyEntry& entry) {
+            if (entry.isExpired(steadyNow)) return;
+            encodeAofEntry(out, entry, entry.expireAt ? entry.expireAt - steadyNow + unixNow : 0);
+        });
+        if (!writeAll(fd, out)) return false;
     }
-        
-    for (const auto& kv : hash_store) {
-        ofs << "H " << kv.first << " ";
-        for (const auto& item : kv.second) {
-            ofs << " " << item.first << ":" << item.second;
+    return true;
+}
+
+bool RedisDatabase::writeAofImage(const std::string& filename) {
+    std::vector<ReadLock> locks;
+    for (auto& shard : shards) locks.emplace_back(shard.mtx);
+    return writeFileAtomically(filename, [&](int fd) { return writeAofEntries(fd); });
+}
+
+pid_t RedisDatabase::forkAofImage(const std::string& filename, const std::function<void()>& beforeFork) {
+    // Same locking as backgroundSave: the child gets a consistent image
+    LatencyTimer stall("aof-rewrite-stall");
+    std::vector<ReadLock> locks;
+    for (auto& shard : shards) locks.emplace_back(shard.mtx);
+    beforeFork();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = fd >= 0 && writeAofEntries(fd) && fsync(fd) == 0;
+        _exit(ok && close(fd) == 0 ? 0 : 1);
+    }
+    if (pid < 0) std::cerr << "Can't rewrite append only file: fork: " << strerror(errno) << "\n";
+    return pid;
+}
+
+bool RedisDatabase::backgroundSave(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(saveMtx);
+    if (saveChild != -1) return false;
+
+    if (!saveProgress) {
+        // Progress counter in memory shared with the children
+        void* mem = mmap(nullptr, sizeof(std::atomic<uint64_t>), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) return false;
+        saveProgress = new (mem) std::atomic<uint64_t>(0);
+    }
+    saveProgress->store(0);
+
+    // Fork with every shard read-locked, so no writer is halfway through a
+    // table update in the image the child inherits. The child never touches
+    // the locks; it only reads its private copy of the keyspace.
+    pid_t pid;
+    uint64_t total = 0;
+    {
+        LatencyTimer stall("snapshot-stall");
+        std::vector<ReadLock> locks;
+        for (auto& shard : shards) locks.emplace_back(shard.mtx);
+        for (const auto& shard : shards) total += shard.table.size();
+        pid = fork();
+        if (pid == 0) {
+            _exit(writeSnapshot(filename, saveProgress) ? 0 : 1);
         }
-        ofs << "\n";
+    }
+    if (pid < 0) {
+        std::cerr << "Can't save in background: fork: " << strerror(errno) << "\n";
+        status.lastBgsaveOk = false;
+        return false;
     }
 
+    std::cout << "Background saving started by pid " << pid << "\n";
+    saveChild = pid;
+    status.inProgress = true;
+    status.startedAtMs = unixNowMs();
+    status.keysTotal = total;
+    std::thread(&RedisDatabase::reapSaveChild, this, pid, filename).detach();
     return true;
 }
 
+void RedisDatabase::reapSaveChild(pid_t pid, const std::string& filename) {
+    int wstatus = 0;
+    while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {}
+    bool ok = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0;
+    // A child killed mid-write (by dump()) never got to remove its file
+    if (!ok) ::unlink(tempFileName(filename, pid).c_str());
+
+    std::lock_guard<std::mutex> lock(saveMtx);
+    int64_t now = unixNowMs();
+    if (ok) {
+        std::cout << "Background saving terminated with success\n";
+        status.lastSaveAtMs = now;
+    } else {
+        std::cerr << "Background saving " << (WIFSIGNALED(wstatus) ? "terminated by signal" : "failed") << "\n";
+    }
+    status.lastBgsaveOk = ok;
+    status.lastBgsaveDurationMs = now - status.startedAtMs;
+    status.inProgress = false;
+    saveChild = -1;
+    saveDone.notify_all();
+}
+
+RedisDatabase::SaveStatus RedisDatabase::saveStatus() const {
+    std::lock_guard<std::mutex> lock(saveMtx);
+    SaveStatus result = status;
+    if (result.inProgress) result.keysSaved = saveProgress->load(std::memory_order_relaxed);
+    return result;
+}
+
 bool RedisDatabase::load(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(mtx); // Lock the mutex for thread safety
-    std::cout << "Loading database from " << filename << "\n";
-    std::ifstream ifs(filename, std::ios::binary);
+    std::vector<WriteLock> locks;
+    for (auto& shard : shards) locks.emplace_back(shard.mtx);
 
-    if (!ifs) {
+    std::cout << "Loading database from " << filename << "\n";
+    int64_t startedAt = steadyNowMs();
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         std::cerr << "Error opening file for reading: " << filename << "\n";
         return false;
     }
+    // Parse the file in place from a read-only mapping instead of copying it
+    struct stat st;
+    size_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    void* map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "Error mapping " << filename << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    if (map) madvise(map, size, MADV_WILLNEED);
+    std::string_view data(static_cast<const char*>(map), size);
 
     // Clear the existing data
-    kv_store.clear();
-    list_store.clear();
-    hash_store.clear();
+    for (auto& shard : shards) {
+        shard.clear();
+    }
+
+    // Files written before the binary format are read by the old parser
+    bool ok = isSnapshot(data) ? loadSnapshot(data, filename) : loadText(std::string(data));
+    if (map) munmap(map, size);
+
+    loaded.keys = 0;
+    for (const auto& shard : shards) loaded.keys += shard.table.size();
+    loaded.durationMs = steadyNowMs() - startedAt;
+    if (ok) std::cout << "Loaded " << loaded.keys << " keys in " << loaded.durationMs << " ms\n";
+    return ok;
+}
+
+RedisDatabase::LoadStatus RedisDatabase::loadStatus() const {
+    return loaded;
+}
+
+bool RedisDatabase::loadSnapshot(std::string_view data, const std::string& filename) {
+    size_t offset = 0;
+    SnapshotHeader header;
+    if (!decodeSnapshotHeader(data, offset, header)) {
+        std::cerr << "Bad snapshot header in " << filename << "\n";
+        return false;
+    }
+    std::vector<SnapshotSection> sections(header.sections);
+    for (uint32_t i = 0; i < header.sections; i++) {
+        if (!decodeSnapshotSection(data, offset, sections[i])) {
+            std::cerr << "Corrupt section " << i << " in " << filename << "\n";
+            return false;
+        }
+    }
+
+    // Section i holds shard i's keys, so when the shard counts match each
+    // worker fills its own shards' tables, pre-sized and without locking.
+    // A key that belongs elsewhere (the file came from a build with other
+    // shards) is set aside and inserted once the workers are done.
+    bool matching = header.sections == SHARD_COUNT;
+    if (matching) {
+        for (size_t i = 0; i < SHARD_COUNT; i++) shards[i].table.reserve(sections[i].entries);
+    }
+
+    int64_t steadyNow = steadyNowMs(), unixNow = unixNowMs();
+    auto place = [&](Shard& shard, std::string_view key, uint64_t hash, SnapshotEntry& item) {
+        shard.erase(key, hash);
+        KeyEntry* entry = shard.insert(key, hash, std::move(item.value));
+        if (item.expireAtMs) shard.setExpireAt(*entry, hash, item.expireAtMs - unixNow + steadyNow);
+    };
+
+    struct Stray {
+        std::string key;
+        SnapshotEntry item;
+    };
+    std::mutex strayMtx;
+    std::vector<Stray> strays;
+    std::atomic<uint32_t> next{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        SnapshotEntry item;
+        std::vector<Stray> local;
+        uint32_t i;
+        while (!failed && (i = next++) < sections.size()) {
+            const SnapshotSection& section = sections[i];
+            if (!verifySnapshotSection(section)) {
+                std::cerr << "Corrupt section " << i << " in " << filename << "\n";
+                failed = true;
+                break;
+            }
+            size_t pos = 0;
+            for (uint32_t n = 0; n < section.entries && !failed; n++) {
+                if (!decodeSnapshotEntry(section.payload, pos, item)) {
+                    std::cerr << "Corrupt entry in section " << i << " of " << filename << "\n";
+                    failed = true;
+                    break;
+                }
+                if (item.expireAtMs && item.expireAtMs <= unixNow) continue;
+
+                uint64_t hash = hashKey(item.key);
+                if (!matching || shardIndex(hash) != i) {
+                    local.push_back(Stray{std::string(item.key), std::move(item)});
+                    continue;
+                }
+                place(shards[i], item.key, hash, item);
+            }
+        }
+        std::lock_guard<std::mutex> lock(strayMtx);
+        for (auto& stray : local) strays.push_back(std::move(stray));
+    };
+
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, sections.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; i++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+    if (failed) return false;
+
+    for (auto& stray : strays) {
+        uint64_t hash = hashKey(stray.key);
+        place(shardFor(hash), stray.key, hash, stray.item);
+    }
+    return true;
+}
+
+bool RedisDatabase::loadText(const std::string& data) {
+    std::istringstream ifs(data);
+
+    // Insert `key`, replacing any earlier line for the same key
+    auto insertKey = [this](const std::string& key, KeyValue&& value) {
+        uint64_t hash = hashKey(key);
+        Shard& shard = shardFor(hash);
+        shard.erase(key, hash);
+        shard.insert(key, hash, std::move(value));
+    };
 
     std::string line;
 
@@ -67,394 +658,543 @@ bool RedisDatabase::load(const std::string& filename) {
         if (type == 'K') {
             std::string key, value;
             iss >> key >> value;
-            kv_store[key] = value;
+            insertKey(key, std::move(value));
         } else if (type == 'L') {
             std::string key;
             iss >> key;
-            std::vector<std::string> list;
+            auto list = std::make_unique<RedisList>();
             std::string item;
             while (iss >> item) {
-                list.push_back(item);
+                list->pushBack(item);
             }
-            list_store[key] = list;
+            insertKey(key, std::move(list));
         } else if (type == 'H') {
             std::string key;
             iss >> key;
-            std::unordered_map<std::string, std::string> hash;
+            auto hash = std::make_unique<RedisHash>();
             std::string pair;
             while (iss >> pair) {
                 auto pos = pair.find(":");
                 if (pos != std::string::npos) {
                     std::string field = pair.substr(0, pos);
                     std::string value = pair.substr(pos+1);
-                    hash[field] = value;
+                    hash->set(field, value);
                 }
             }
-            hash_store[key] = hash;
+            insertKey(key, std::move(hash));
         }
-        
-    } 
-    
-    return true;
-}
 
-bool RedisDatabase::flushAll() {
-    std::lock_guard<std::mutex> lock(mtx);
-    kv_store.clear();
-    list_store.clear();
-    hash_store.clear();
+    }
+
     return true;
 }
 
-void RedisDatabase::removeIfExpired(const std::string& key) {
-    auto it = expiry_map.find(key);
-    if (it != expiry_map.end() && std::chrono::steady_clock::now() > it->second) {
-        kv_store.erase(key);
-        list_store.erase(key);
-        hash_store.erase(key);
-        expiry_map.erase(it);
+bool RedisDatabase::flushAll(bool async) {
+    // Detach every table under all the shard locks at once, so the flush is
+    // a single point in each shard's order of writes (and in the log), then
+    // free them with the locks released
+    std::vector<std::unique_ptr<KeyspaceTable>> tables;
+    std::vector<std::vector<ExpireItem>> expires(SHARD_COUNT);
+    {
+        std::vector<WriteLock> locks;
+        for (auto& shard : shards) locks.emplace_back(shard.mtx);
+        for (size_t i = 0; i < SHARD_COUNT; i++) {
+            Shard& shard = shards[i];
+            tables.push_back(std::make_unique<KeyspaceTable>());
+            tables.back()->swap(shard.table);
+            expires[i].swap(shard.expires);
+            shard.typeCounts.fill(0);
+            shard.volatileKeys = 0;
+        }
+        propagate({"FLUSHALL"});
     }
+    if (async) {
+        for (size_t i = 0; i < SHARD_COUNT; i++)
+            LazyFree::getInstance().freeTable(std::move(tables[i]), std::move(expires[i]));
+    }
+    return true;
 }
 
 // Key-Value Operations
-void RedisDatabase::set(const std::string& key, const std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    kv_store[key] = value;
-}
-
-bool RedisDatabase::get(const std::string& key, std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = kv_store.find(key);
-    if (it != kv_store.end()) {
-        value = it->second;
-        return true;
-    }
-    return false;
+void RedisDatabase::set(std::string_view key, std::string_view value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.table.find(key, hash);
+    // SET replaces a value of any type and clears its TTL
+    if (!entry)
+        entry = shard.insert(key, hash, std::string(value));
+    else if (entry->type() == ObjectType::String)
+        entry->setString(value);
+    else
+        shard.setValue(*entry, std::string(value));
+    shard.setExpireAt(*entry, hash, 0);
+    propagate({"SET", key, value});
 }
 
-bool RedisDatabase::del(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    bool erased = false;
-    erased |= kv_store.erase(key) > 0;
-    erased |= list_store.erase(key) > 0;
-    erased |= hash_store.erase(key) > 0;
+bool RedisDatabase::get(std::string_view key, std::string& value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (!entry) return false;
+    value.assign(stringOf(*entry));
+    return true;
+}
 
-    return erased;
+bool RedisDatabase::del(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    if (!shard.findForWrite(key, hash)) return false;
+    shard.erase(key, hash);
+    propagate({"DEL", key});
+    return true;
 }
 
-bool RedisDatabase::exists(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    return kv_store.count(key) || list_store.count(key) || hash_store.count(key);
+bool RedisDatabase::unlink(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    KeyEntryPtr entry;
+    {
+        WriteLock lock(shard.mtx);
+        if (!shard.findForWrite(key, hash)) return false;
+        entry = shard.remove(key, hash);
+        propagate({"DEL", key});
+    }
+    LazyFree::getInstance().freeEntry(std::move(entry));
+    return true;
 }
 
-std::string RedisDatabase::type(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    
-    if (kv_store.find(key) != kv_store.end())   return "string";
+bool RedisDatabase::exists(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    return shard.findLive(key, hash) != nullptr;
+}
 
-    if (list_store.find(key) != list_store.end())   return "list";
-    
-    if (hash_store.find(key) != hash_store.end())   return "hash";
-    
-    else return "none";
+std::string RedisDatabase::type(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    return entry ? typeName(entry->type()) : "none";
 }
 
-bool RedisDatabase::expire(const std::string& key, int seconds) {
-    std::lock_guard<std::mutex> lock(mtx);
-    bool exist = kv_store.find(key) != kv_store.end() || 
-                 list_store.find(key) != list_store.end() ||
-                 hash_store.find(key) != hash_store.end();
-    if (!exist) return false;
+bool RedisDatabase::expire(std::string_view key, int seconds) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return false;
+
+    // A TTL of zero or less deletes the key at once, as a past deadline
+    // does in expireAt() (and, as there, not while replaying)
+    if (seconds <= 0 && !loadingLog.load(std::memory_order_relaxed)) {
+        shard.erase(key, hash);
+        propagate({"DEL", key});
+        return true;
+    }
+    shard.setExpireAt(*entry, hash, steadyNowMs() + static_cast<int64_t>(seconds) * 1000);
+    // A relative TTL would restart on replay; log the absolute deadline
+    std::string when = std::to_string(unixNowMs() + static_cast<int64_t>(seconds) * 1000);
+    propagate({"PEXPIREAT", key, when});
 
-    expiry_map[key] = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
-    
     return true;
 }
 
-bool RedisDatabase::rename(const std::string& oldKey, const std::string& newKey) {
-    std::lock_guard<std::mutex> lock(mtx);
-    bool found = false;
+bool RedisDatabase::expireAt(std::string_view key, int64_t unixMs) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return false;
 
-    auto itKv = kv_store.find(oldKey);
-    if(itKv != kv_store.end()) {
-        kv_store[newKey] = itKv -> second;
-        kv_store.erase(itKv);
-        found = true;
+    // A deadline already in the past deletes the key, except during replay:
+    // the key is kept with its deadline and expires once loading is done
+    int64_t steadyNow = steadyNowMs();
+    int64_t deadline = unixMs - unixNowMs() + steadyNow;
+    std::string when = std::to_string(unixMs);
+    propagate({"PEXPIREAT", key, when});
+    if (deadline <= steadyNow && !loadingLog.load(std::memory_order_relaxed)) {
+        shard.erase(key, hash);
+        return true;
     }
+    shard.setExpireAt(*entry, hash, deadline);
 
-    auto itList = list_store.find(oldKey);
-    if(itList != list_store.end()) {
-        list_store[newKey] = itList -> second;
-        list_store.erase(itList);
-        found = true;
-    }
+    return true;
+}
 
-    auto itHash = hash_store.find(oldKey);
-    if(itHash != hash_store.end()) {
-        hash_store[newKey] = itHash -> second;
-        hash_store.erase(itHash);
-        found = true;
-    }
+bool RedisDatabase::rename(std::string_view oldKey, std::string_view newKey) {
+    // Lock both shards, lower index first, so two concurrent renames in
+    // opposite directions cannot deadlock.
+    uint64_t fromHash = hashKey(oldKey), toHash = hashKey(newKey);
+    size_t from = shardIndex(fromHash), to = shardIndex(toHash);
+    WriteLock first(shards[std::min(from, to)].mtx);
+    WriteLock second;
+    if (from != to) second = WriteLock(shards[std::max(from, to)].mtx);
 
-    auto itExpiry = expiry_map.find(oldKey);
-    if(itExpiry != expiry_map.end()) {
-        expiry_map[newKey] = itExpiry -> second;
-        expiry_map.erase(itExpiry);
-    }
+    Shard& src = shards[from];
+    Shard& dst = shards[to];
+    if (!src.findForWrite(oldKey, fromHash)) return false;
+    if (oldKey == newKey) return true;
+    propagate({"RENAME", oldKey, newKey});
 
-    return found;
+    // The new name replaces whatever it held before; value and TTL move over
+    KeyEntryPtr entry = src.remove(oldKey, fromHash);
+    dst.erase(newKey, toHash);
+    KeyEntry* target = dst.insert(newKey, toHash, entry->takeValue());
+    target->access.store(entry->access.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if (entry->expireAt != 0) dst.setExpireAt(*target, toHash, entry->expireAt);
 
+    return true;
+}
+
+long long RedisDatabase::memoryUsage(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    return entry ? static_cast<long long>(entry->memoryUsage()) : -1;
 }
 
 // List Operations
-ssize_t RedisDatabase::llen(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = list_store.find(key);
-    if (it != list_store.end())
-        return it->second.size();
-    return 0;
-}
-
-void RedisDatabase::lpush(const std::string& key, const std::vector<std::string>& values) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto& list = list_store[key];
+ssize_t RedisDatabase::llen(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    return entry ? listOf(*entry).size() : 0;
+}
+
+size_t RedisDatabase::lpush(std::string_view key, const std::string_view* values, size_t count) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) entry = shard.insert(key, hash, std::make_unique<RedisList>());
+    RedisList& list = listOf(*entry);
     // Insert each value at the head, leftmost value first (Redis semantics)
-    for (auto it = values.rbegin(); it != values.rend(); ++it) {
-        list.insert(list.begin(), *it);
+    for (size_t i = 0; i < count; i++) {
+        list.pushFront(values[i]);
     }
+    propagate("LPUSH", key, values, count);
+    return list.size();
 }
 
-void RedisDatabase::rpush(const std::string& key, const std::vector<std::string>& values) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto& list = list_store[key];
-    for (const auto& value : values) {
-        list.push_back(value);
+size_t RedisDatabase::rpush(std::string_view key, const std::string_view* values, size_t count) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) entry = shard.insert(key, hash, std::make_unique<RedisList>());
+    RedisList& list = listOf(*entry);
+    for (size_t i = 0; i < count; i++) {
+        list.pushBack(values[i]);
     }
+    propagate("RPUSH", key, values, count);
+    return list.size();
 }
 
-bool RedisDatabase::lpop(const std::string& key, std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = list_store.find(key);
-    if (it != list_store.end() && !it->second.empty()) {
-        value = it->second.front();
-        it->second.erase(it->second.begin());
-        return true;
-    }
+bool RedisDatabase::lpop(std::string_view key, std::string& value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return false;
+    RedisList& list = listOf(*entry);
+    if (!list.popFront(value)) return false;
+    propagate({"LPOP", key});
+    // A list that becomes empty is removed, as in Redis
+    if (list.empty()) shard.erase(key, hash);
+    return true;
+}
 
-    return false;
+bool RedisDatabase::rpop(std::string_view key, std::string& value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return false;
+    RedisList& list = listOf(*entry);
+    if (!list.popBack(value)) return false;
+    propagate({"RPOP", key});
+    if (list.empty()) shard.erase(key, hash);
+    return true;
 }
 
-bool RedisDatabase::rpop(const std::string& key, std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = list_store.find(key);
-    if (it != list_store.end() && !it->second.empty()) {
-        value = it->second.back();
-        it->second.pop_back();
-        return true;
-    }
-
-    return false;
-}
-
-int RedisDatabase::lrem(const std::string& key, int count, const std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    int removed = 0;
-    auto it = list_store.find(key);
-    if (it == list_store.end())
-        return 0;
-    auto& list = it->second;
-
-    if (count == 0) {
-        // Remove all occurances
-        auto new_end = std::remove(list.begin(), list.end(), value);
-        removed = std::distance(new_end, list.end());
-        list.erase(new_end, list.end());
-    } else if (count < 0) {
-        // Remove from tail to head
-        for (auto riter = list.rbegin(); riter != list.rend() && removed < (-count); ) {
-            if (*riter == value) {
-                auto fwdIterator = riter.base();
-                --fwdIterator;
-                fwdIterator = list.erase(fwdIterator);
-                ++removed;
-                riter = std::reverse_iterator<std::vector<std::string>::iterator>(fwdIterator);
-            } else {
-                ++riter;
-            }
-        }
-    } else {
-        // Remove from head to tail
-        for (auto iter = list.begin(); iter != list.end() && removed < count; ) {
-            if (*iter == value) {
-                iter = list.erase(iter);
-                ++removed;
-            } else {
-                ++iter;
-            }
-        }
+int RedisDatabase::lrem(std::string_view key, int count, std::string_view value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return 0;
+    auto& list = listOf(*entry);
+    int removed = list.remove(count, value);
+    if (list.empty()) shard.erase(key, hash);
+    if (removed > 0) {
+        std::string n = std::to_string(count);
+        propagate({"LREM", key, n, value});
     }
     return removed;
 }
 
-bool RedisDatabase::lindex(const std::string& key, int index, std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = list_store.find(key);
-    if (it == list_store.end())
-        return false;
-    
-    const auto& list = it->second;
-    if (index < 0)
-        index = list.size() + index;
-    if (index < 0 || index >= static_cast<int>(list.size())) 
-        return false;
-    
-    value = list[index];
+bool RedisDatabase::lindex(std::string_view key, int index, std::string& value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (!entry) return false;
 
-    return true;
+    return listOf(*entry).index(index, value);
 }
 
-bool RedisDatabase::lset(const std::string& key, int index, const std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = list_store.find(key);
-    if (it == list_store.end())
-        return false;
-    
-    auto& list = it->second;
-    if (index < 0)
-        index = list.size() + index;
-    if (index < 0 || index >= static_cast<int>(list.size())) 
-        return false;
-    
-    list[index] = value;
+bool RedisDatabase::lset(std::string_view key, int index, std::string_view value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return false;
+
+    if (!listOf(*entry).set(index, value)) return false;
+    std::string n = std::to_string(index);
+    propagate({"LSET", key, n, value});
     return true;
 }
 
 // Hash Operations
-int RedisDatabase::hset(const std::string& key, const std::string& field, const std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    int updated = (hash_store[key][field] != value);
-    hash_store[key][field] = value;
-    return updated;
+
+int RedisDatabase::hset(std::string_view key, std::string_view field, std::string_view value) {
+    return hmset(key, std::array<std::string_view, 2>{field, value}.data(), 2);
 }
 
-bool RedisDatabase::hget(const std::string& key, const std::string& field, std::string& value) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        auto fit = it->second.find(field);
-        if (fit != it->second.end()) {
-            value = fit->second;
-            return true;
-        }
-    }
-    return false;
+bool RedisDatabase::hget(std::string_view key, std::string_view field, std::string& value) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (!entry) return false;
+    return hashOf(*entry).get(field, value);
 }
 
-bool RedisDatabase::hexists(const std::string& key, const std::string& field) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        return it->second.find(field) != it->second.end();
-    }
-    return false;
+bool RedisDatabase::hexists(std::string_view key, std::string_view field) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (!entry) return false;
+    return hashOf(*entry).exists(field);
 }
 
-int RedisDatabase::hdel(const std::string& key, const std::string& field) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        return it->second.erase(field);
-    }
-    return 0;
+int RedisDatabase::hdel(std::string_view key, std::string_view field) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) return 0;
+    RedisHash& fields = hashOf(*entry);
+    int removed = fields.del(field);
+    // A hash that becomes empty is removed, as in Redis
+    if (fields.empty()) shard.erase(key, hash);
+    if (removed > 0) propagate({"HDEL", key, field});
+    return removed;
+}
+
+uint64_t RedisDatabase::hscan(std::string_view key, uint64_t cursor, size_t count, std::string_view pattern,
+                              std::vector<std::pair<std::string, std::string>>& out) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (!entry) return 0;
+    bool matchAll = pattern == "*";
+    return hashOf(*entry).scan(cursor, count, [&](std::string_view field, std::string_view value) {
+        if (matchAll || globMatch(pattern, field)) out.emplace_back(field, value);
+    });
 }
 
-std::unordered_map<std::string, std::string> RedisDatabase::hgetall(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    std::unordered_map<std::string, std::string> result;
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        result = it->second;
+std::vector<std::pair<std::string, std::string>> RedisDatabase::hgetall(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    std::vector<std::pair<std::string, std::string>> result;
+    if (entry) {
+        const RedisHash& fields = hashOf(*entry);
+        result.reserve(fields.size());
+        fields.forEach([&](std::string_view field, std::string_view value) {
+            result.emplace_back(field, value);
+        });
     }
     return result;
 }
 
-std::vector<std::string> RedisDatabase::hkeys(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
+std::vector<std::string> RedisDatabase::hkeys(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
     std::vector<std::string> result;
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        for (const auto& kv : it->second) {
-            result.push_back(kv.first);
-        }
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (entry) {
+        hashOf(*entry).forEach([&](std::string_view field, std::string_view) {
+            result.emplace_back(field);
+        });
     }
     return result;
 }
 
-std::vector<std::string> RedisDatabase::hvals(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
+std::vector<std::string> RedisDatabase::hvals(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
     std::vector<std::string> result;
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        for (const auto& kv : it->second) {
-            result.push_back(kv.second);
-        }
+    KeyEntry* entry = shard.findLive(key, hash);
+    if (entry) {
+        hashOf(*entry).forEach([&](std::string_view, std::string_view value) {
+            result.emplace_back(value);
+        });
     }
     return result;
 }
 
-int RedisDatabase::hlen(const std::string& key) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
-    auto it = hash_store.find(key);
-    if (it != hash_store.end()) {
-        return it->second.size();
-    }
-    return 0;
+int RedisDatabase::hlen(std::string_view key) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    ReadLock lock(shard.mtx);
+    KeyEntry* entry = shard.findLive(key, hash);
+    return entry ? hashOf(*entry).size() : 0;
 }
 
-int RedisDatabase::hmset(const std::string& key, const std::vector<std::pair<std::string, std::string>>& field_values) {
-    removeIfExpired(key);
-    std::lock_guard<std::mutex> lock(mtx);
+int RedisDatabase::hmset(std::string_view key, const std::string_view* field_values, size_t count) {
+    uint64_t hash = hashKey(key);
+    Shard& shard = shardFor(hash);
+    WriteLock lock(shard.mtx);
+    KeyEntry* entry = shard.findForWrite(key, hash);
+    if (!entry) entry = shard.insert(key, hash, std::make_unique<RedisHash>());
+    RedisHash& fields = hashOf(*entry);
     int updated = 0;
-    for (const auto& fv : field_values) {
-        updated += (hash_store[key][fv.first] != fv.second);
-        hash_store[key][fv.first] = fv.second;
+    for (size_t i = 0; i + 1 < count; i += 2) {
+        updated += fields.set(field_values[i], field_values[i + 1]);
     }
+    propagate("HSET", key, field_values, count & ~size_t(1));
     return updated;
 }
 
-std::vector<std::string> RedisDatabase::keys() {
-    std::lock_guard<std::mutex> lock(mtx);
+std::vector<std::string> RedisDatabase::keys(std::string_view pattern) {
+    // Hold every shard's read lock, taken in index order, so the result is
+    // one consistent view of the keyspace.
+    std::vector<ReadLock> locks;
+    for (auto& shard : shards) locks.emplace_back(shard.mtx);
+
     std::vector<std::string> all_keys;
-    for (const auto& kv : kv_store) {
-        all_keys.push_back(kv.first);
+    int64_t now = steadyNowMs();
+    bool matchAll = pattern == "*";
+    for (const auto& shard : shards) {
+        shard.table.forEach([&](const KeyEntry& entry) {
+            if (entry.isExpired(now)) return;
+            if (matchAll || globMatch(pattern, entry.key())) all_keys.emplace_back(entry.key());
+        });
     }
-    for (const auto& kv : list_store) {
-        all_keys.push_back(kv.first);
+    return all_keys;
+
+}
+
+uint64_t RedisDatabase::scan(uint64_t cursor, size_t count, std::string_view pattern, std::vector<std::string>& out) {
+    // The low bits of the cursor pick the shard, the rest is that shard's
+    // table cursor. Shards are walked in order, each under its read lock
+    // for one call at most, so a walk never holds up writers for long.
+    size_t shard = cursor % SHARD_COUNT;
+    uint64_t tableCursor = cursor / SHARD_COUNT;
+    size_t steps = 0, maxSteps = count * 10;
+    int64_t now = steadyNowMs();
+    bool matchAll = pattern == "*";
+    auto collect = [&](const KeyEntry& entry) {
+        if (entry.isExpired(now)) return;
+        if (matchAll || globMatch(pattern, entry.key())) out.emplace_back(entry.key());
+    };
+
+    while (out.size() < count && steps < maxSteps) {
+        {
+            ReadLock lock(shards[shard].mtx);
+            do {
+                tableCursor = shards[shard].table.scan(tableCursor, collect);
+                steps++;
+            } while (tableCursor != 0 && out.size() < count && steps < maxSteps);
+        }
+        if (tableCursor == 0 && ++shard == SHARD_COUNT) return 0;
     }
-    for (const auto& kv : hash_store) {
-        all_keys.push_back(kv.first);
+    return tableCursor * SHARD_COUNT + shard;
+}
+
+void RedisDatabase::sampleForEviction(Shard& shard, EvictionPolicy policy, size_t samples, uint64_t start) {
+    int64_t now = steadyNowMs();
+    auto consider = [&](const KeyEntry& entry, uint64_t hash) {
+        uint64_t score = evictionScore(entry, policy, now);
+        if (evictionPool.size() == EVICTION_POOL_SIZE && score <= evictionPool.front().score) return;
+        for (const auto& candidate : evictionPool) {
+            if (candidate.hash == hash && candidate.key == entry.key()) return;
+        }
+        // Keep the pool sorted by score, dropping the weakest when it is full
+        auto it = std::upper_bound(evictionPool.begin(), evictionPool.end(), score,
+            [](uint64_t s, const EvictionCandidate& c) { return s < c.score; });
+        evictionPool.insert(it, EvictionCandidate{score, hash, std::string(entry.key())});
+        if (evictionPool.size() > EVICTION_POOL_SIZE) evictionPool.erase(evictionPool.begin());
+    };
+
+    ReadLock lock(shard.mtx);
+    if (isVolatilePolicy(policy)) {
+        // Keys with a TTL are exactly those in the expiry heap (minus its
+        // stale items), so sample there instead of the whole table
+        if (shard.expires.empty()) return;
+        for (size_t i = 0; i < samples; i++) {
+            const ExpireItem& item = shard.expires[(start + i * 7919) % shard.expires.size()];
+            const KeyEntry* entry = shard.table.find(item.key, item.hash);
+            if (entry && entry->expireAt == item.deadline) consider(*entry, item.hash);
+        }
+        return;
     }
-    return all_keys;
+    shard.table.sample(start, samples, consider);
+}
+
+bool RedisDatabase::freeMemoryIfNeeded() {
+    const ServerConfig& config = ServerConfig::getInstance();
+    if (config.maxmemory == 0 || usedMemory() <= config.maxmemory) return true;
+    EvictionPolicy policy = evictionPolicy();
+    if (policy == EvictionPolicy::NoEviction) return false;
 
-}
\ No newline at end of file
+    // One evictor at a time; the others wait and usually find memory
+    // already back under the limit
+    std::lock_guard<std::mutex> lock(evictMtx);
+    LatencyTimer stall("eviction-cycle");
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    size_t fruitless = 0;
+    while (usedMemory() > config.maxmemory) {
+        // Sample one random shard per round into the pool of the best
+        // candidates seen so far, then evict the best of the pool
+        sampleForEviction(shards[rng() % SHARD_COUNT], policy, config.maxmemorySamples, rng());
+        if (evictionPool.empty()) {
+            // Nothing evictable in the sampled shards; give up once every
+            // shard has had several chances
+            if (++fruitless > SHARD_COUNT * 4) return false;
+            continue;
+        }
+
+        EvictionCandidate victim = std::move(evictionPool.back());
+        evictionPool.pop_back();
+        Shard& shard = shardFor(victim.hash);
+        WriteLock shardLock(shard.mtx);
+        // The candidate may have been deleted, or lost its TTL, since it was sampled
+        KeyEntry* entry = shard.table.find(victim.key, victim.hash);
+        if (!entry || (isVolatilePolicy(policy) && entry->expireAt == 0)) continue;
+        shard.erase(victim.key, victim.hash);
+        propagate({"DEL", victim.key});
+        shardLock.unlock();
+        evicted.fetch_add(1, std::memory_order_relaxed);
+        fruitless = 0;
+    }
+    return true;
+}
+
+uint64_t RedisDatabase::evictedKeyCount() const {
+    return evicted.load(std::memory_order_relaxed);
+}
@@ -1,6 +1,9 @@
 #include "../include/RedisServer.h"
 #include "../include/RedisCommandHandler.h"
 #include "../include/RedisDatabase.h"
+#include "../include/EventLoop.h"
+#include "../include/ServerConfig.h"
+#include "../include/AppendOnlyFile.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <iostream>
@@ -26,85 +29,102 @@ void RedisServer::setupSignalHandler(){
     signal(SIGINT, signalHandler);
 }
 
-RedisServer::RedisServer(int port) : port(port), server_fd(-1), running(true) {
+RedisServer::RedisServer(int port, int ioThreads)
+    : port(port), ioThreads(ioThreads > 0 ? ioThreads : 1), running(true) {
     globalServer = this;
     setupSignalHandler();
 }
 
 void RedisServer::shutdown() {
     running = false;
-    if (server_fd != -1) {
-        if (RedisDatabase::getInstance().dump("dump.my_rdb")) {
-            std::cout << "Database dumped to dump.my_rdb successfully\n";
+    if (!listen_fds.empty()) {
+        AppendOnlyFile::getInstance().close();
+        const std::string& filename = ServerConfig::getInstance().dbFilename;
+        if (RedisDatabase::getInstance().dump(filename)) {
+            std::cout << "Database dumped to " << filename << " successfully\n";
         } else {
             std::cerr << "Error dumping database\n";
         }
-        close(server_fd);
+        for (int fd : listen_fds) close(fd);
     }
     std::cout << "Server shutdown complete\n";
 }
 
-void RedisServer::run() {
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
+// Create a non-blocking listening socket on `port`. SO_REUSEPORT lets every
+// reactor bind its own socket so the kernel spreads new connections across
+// them without a shared accept queue. Returns -1 on failure.
+int RedisServer::createListener() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
         std::cerr << "Error creating server socket\n";
-        return; 
+        return -1;
     }
 
     int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        std::cerr << "Error setting SO_REUSEPORT\n";
+        close(fd);
+        return -1;
+    }
+
     struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    
-    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         std::cerr << "Error binding server socket\n";
-        return;
+        close(fd);
+        return -1;
     }
 
-    int connection_backlog = 10;
-    if (listen(server_fd, connection_backlog) < 0) {
+    if (listen(fd, SOMAXCONN) < 0) {
         std::cerr << "listen failed\n";
-        return;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void RedisServer::run() {
+    for (int i = 0; i < ioThreads; i++) {
+        int fd = createListener();
+        if (fd < 0) {
+            for (int open_fd : listen_fds) close(open_fd);
+            listen_fds.clear();
+            return;
+        }
+        listen_fds.push_back(fd);
     }
 
-    std::cout << "Redis Server Listening On Port: " << port << ".\n";
+    std::cout << "Redis Server Listening On Port: " << port << " (" << ioThreads
+              << " I/O threads).\n";
+
+    // Each reactor owns its listener, epoll set, connection table and command
+    // handler, so nothing on the network path is shared between cores.
+    auto reactor = [this](int listen_fd) {
+        RedisCommandHandler cmdHandler;
+        EventLoop loop(listen_fd, cmdHandler);
+        loop.run(running);
+    };
 
     std::vector<std::thread> threads;
-    RedisCommandHandler cmdHandler;
-
-    while (running) {
-        int client_fd = accept(server_fd, nullptr, nullptr);
-    
-        threads.emplace_back([client_fd, &cmdHandler]() {
-            char buffer[1024];
-            while (true) {
-                memset(buffer, 0, sizeof(buffer));
-                int bytes = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-                if (bytes <= 0) break;
-                
-                std::string request(buffer, bytes);
-
-                std::string response = cmdHandler.handleCommand(request);
-                send(client_fd, response.c_str(), response.size(), 0);
-            }
-            // std::cout << "dbg HERE\n";
-            close(client_fd);
-        });
+    for (int i = 1; i < ioThreads; i++) {
+        threads.emplace_back(reactor, listen_fds[i]);
     }
-    
+    reactor(listen_fds[0]);
+
     for (auto& t: threads){
         if (t.joinable()) t.join();
     }
 
-    if (RedisDatabase::getInstance().dump("dump.my_rdb")) {
-        std::cout << "Database dumped to dump.my_rdb successfully\n";
+    AppendOnlyFile::getInstance().close();
+    const std::string& filename = ServerConfig::getInstance().dbFilename;
+    if (RedisDatabase::getInstance().dump(filename)) {
+        std::cout << "Database dumped to " << filename << " successfully\n";
     } else {
         std::cerr << "Error dumping database\n";
     }
-
-    // Shutdown
-
-}
\ No newline at end of file
+}
@@ -0,0 +1,139 @@
+#include "../include/ReplyBuffer.h"
+#include <algorithm>
+
+// Chunk that small replies are appended to, starting a new one when the
+// current tail is sealed or would outgrow CHUNK_SIZE. A new chunk is sized
+// to the reply and grows (doubling, up to CHUNK_SIZE) as more are added, so
+// a client that gets a short reply now and then never holds a full chunk.
+std::string& ReplyBuffer::tail(size_t need) {
+    if (chunks.empty() || chunks.back().sealed ||
+        (chunks.back().data.size() + need > CHUNK_SIZE && !chunks.back().data.empty())) {
+        chunks.push_back(Chunk{std::string(), false});
+        chunks.back().data.reserve(need);
+    } else {
+        std::string& data = chunks.back().data;
+        size_t size = data.size() + need;
+        if (size > data.capacity()) data.reserve(std::max(size, std::min(data.capacity() * 2, size_t(CHUNK_SIZE))));
+    }
+    total += need;
+    return chunks.back().data;
+}
+
+void ReplyBuffer::addRaw(std::string_view bytes) {
+    tail(bytes.size()).append(bytes.data(), bytes.size());
+}
+
+// Write "<prefix><value>\r\n" into `out` (at least 32 bytes) and return its length
+static size_t formatLine(char* out, char prefix, long long value) {
+    char digits[20];
+    int n = 0;
+    unsigned long long v = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                     : static_cast<unsigned long long>(value);
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+
+    size_t len = 0;
+    out[len++] = prefix;
+    if (value < 0) out[len++] = '-';
+    while (n) out[len++] = digits[--n];
+    out[len++] = '\r';
+    out[len++] = '\n';
+    return len;
+}
+
+void ReplyBuffer::addSimpleString(std::string_view str) {
+    std::string& out = tail(str.size() + 3);
+    out += '+';
+    out.append(str.data(), str.size());
+    out += "\r\n";
+}
+
+void ReplyBuffer::addError(std::string_view msg) {
+    errors++;
+    std::string& out = tail(msg.size() + 3);
+    out += '-';
+    out.append(msg.data(), msg.size());
+    out += "\r\n";
+}
+
+void ReplyBuffer::addInteger(long long value) {
+    char buf[32];
+    addRaw(std::string_view(buf, formatLine(buf, ':', value)));
+}
+
+void ReplyBuffer::addNull() {
+    addRaw("$-1\r\n");
+}
+
+void ReplyBuffer::addArrayHeader(size_t count) {
+    char buf[32];
+    addRaw(std::string_view(buf, formatLine(buf, '*', static_cast<long long>(count))));
+}
+
+void ReplyBuffer::addBulkString(std::string_view value) {
+    char buf[32];
+    size_t len = formatLine(buf, '$', static_cast<long long>(value.size()));
+    std::string& out = tail(len + value.size() + 2);
+    out.append(buf, len);
+    out.append(value.data(), value.size());
+    out += "\r\n";
+}
+
+void ReplyBuffer::addBulkString(std::string&& value) {
+    if (value.size() < LARGE_VALUE) {
+        addBulkString(std::string_view(value));
+        return;
+    }
+    char buf[32];
+    addRaw(std::string_view(buf, formatLine(buf, '$', static_cast<long long>(value.size()))));
+    total += value.size();
+    chunks.push_back(Chunk{std::move(value), true});
+    addRaw("\r\n");
+}
+
+int ReplyBuffer::fillIovec(struct iovec* iov, int max) const {
+    int n = 0;
+    size_t skip = headOffset;
+    for (const auto& chunk : chunks) {
+        if (n == max) break;
+        if (chunk.data.size() == skip) {
+            skip = 0;
+            continue;
+        }
+        iov[n].iov_base = const_cast<char*>(chunk.data.data()) + skip;
+        iov[n].iov_len = chunk.data.size() - skip;
+        skip = 0;
+        n++;
+    }
+    return n;
+}
+
+void ReplyBuffer::consume(size_t bytes) {
+    headOffset += bytes;
+    while (!chunks.empty() && headOffset >= chunks.front().data.size()) {
+        headOffset -= chunks.front().data.size();
+        total -= chunks.front().data.size();
+        // Fully written chunks are freed, the last one too: a connection
+        // with nothing to send holds no reply memory
+        chunks.pop_front();
+    }
+}
+
+std::string ReplyBuffer::str() const {
+    std::string result;
+    result.reserve(pending());
+    size_t skip = headOffset;
+    for (const auto& chunk : chunks) {
+        result.append(chunk.data, skip, std::string::npos);
+        skip = 0;
+    }
+    return result;
+}
+
+void ReplyBuffer::clear() {
+    chunks.clear();
+    headOffset = 0;
+    total = 0;
+}
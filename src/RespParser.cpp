@@ -0,0 +1,167 @@
+#include "../include/RespParser.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+bool parseInteger(std::string_view str, long long& out) {
+    if (str.empty() || str.size() > 20) return false;
+
+    size_t i = 0;
+    bool negative = false;
+    if (str[0] == '-') {
+        if (str.size() == 1) return false;
+        negative = true;
+        i = 1;
+    }
+
+    unsigned long long value = 0;
+    for (; i < str.size(); i++) {
+        unsigned digit = static_cast<unsigned char>(str[i]) - '0';
+        if (digit > 9) return false;
+        if (value > (std::numeric_limits<unsigned long long>::max() - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+
+    const unsigned long long maxPositive = std::numeric_limits<long long>::max();
+    if (negative) {
+        if (value > maxPositive + 1) return false;
+        out = value == maxPositive + 1 ? std::numeric_limits<long long>::min()
+                                       : -static_cast<long long>(value);
+    } else {
+        if (value > maxPositive) return false;
+        out = static_cast<long long>(value);
+    }
+    return true;
+}
+
+// Parse the length header in buf[begin, end)
+static bool parseLength(const std::string& buf, size_t begin, size_t end, long long& out) {
+    return parseInteger(std::string_view(buf.data() + begin, end - begin), out);
+}
+
+// Split buf[begin, end) on whitespace
+static void splitInline(const std::string& buf, size_t begin, size_t end,
+                        std::vector<std::string_view>& tokens) {
+    tokens.clear();
+    size_t i = begin;
+    while (i < end) {
+        while (i < end && std::isspace(static_cast<unsigned char>(buf[i]))) i++;
+        size_t start = i;
+        while (i < end && !std::isspace(static_cast<unsigned char>(buf[i]))) i++;
+        if (i > start) tokens.emplace_back(buf.data() + start, i - start);
+    }
+}
+
+void RespParser::reset() {
+    argsLeft = -1;
+    bulkLen = -1;
+    spans.clear();
+}
+
+RespParser::Status RespParser::fail(const char* msg) {
+    errorMsg = msg;
+    reset();
+    return Status::Error;
+}
+
+void RespParser::compact() {
+    pos -= frameStart;
+    for (auto& span : spans) span.first -= frameStart;
+    frameStart = 0;
+}
+
+// Sample RESP "*2\r\n$5\r\nhello\r\n$5\r\nworld\r\n"
+RespParser::Status RespParser::next(const std::string& buf, std::vector<std::string_view>& tokens) {
+    while (true) {
+        if (argsLeft < 0) {
+            // Start of a new frame: expect '*' followed by the number of elements
+            if (pos >= buf.size()) return Status::NeedMore;
+            if (buf[pos] != '*') {
+                Status status = parseInline(buf, tokens);
+                if (status == Status::Command && tokens.empty()) continue; // Blank line
+                return status;
+            }
+
+            // crlf = carriage return (\r) + line feed (\n)
+            size_t crlf = buf.find("\r\n", pos);
+            if (crlf == std::string::npos) {
+                if (buf.size() - pos > MAX_INLINE_LEN) return fail("too big mbulk count string");
+                return Status::NeedMore;
+            }
+            long long numElements;
+            if (!parseLength(buf, pos + 1, crlf, numElements) || numElements > MAX_ARGS)
+                return fail("invalid multibulk length");
+            pos = crlf + 2;
+            if (numElements <= 0) {
+                // Empty command: nothing to run, skip it
+                frameStart = pos;
+                continue;
+            }
+            argsLeft = numElements;
+            spans.clear();
+            spans.reserve(std::min<long long>(numElements, 1024));
+        }
+
+        while (argsLeft > 0) {
+            if (bulkLen < 0) {
+                if (pos >= buf.size()) return Status::NeedMore;
+                if (buf[pos] != '$') return fail("expected '$'");
+                size_t crlf = buf.find("\r\n", pos);
+                if (crlf == std::string::npos) {
+                    if (buf.size() - pos > MAX_INLINE_LEN) return fail("too big bulk count string");
+                    return Status::NeedMore;
+                }
+                long long len;
+                if (!parseLength(buf, pos + 1, crlf, len) || len < 0 || len > MAX_BULK_LEN)
+                    return fail("invalid bulk length");
+                bulkLen = len;
+                pos = crlf + 2;
+            }
+
+            // Wait until the payload and its trailing CRLF are buffered
+            if (buf.size() - pos < static_cast<size_t>(bulkLen) + 2) return Status::NeedMore;
+            if (buf[pos + bulkLen] != '\r' || buf[pos + bulkLen + 1] != '\n')
+                return fail("bulk string not terminated by CRLF");
+            spans.emplace_back(pos, static_cast<size_t>(bulkLen));
+            pos += bulkLen + 2;
+            bulkLen = -1;
+            argsLeft--;
+        }
+
+        tokens.clear();
+        for (const auto& span : spans) {
+            tokens.emplace_back(buf.data() + span.first, span.second);
+        }
+        reset();
+        frameStart = pos;
+        return Status::Command;
+    }
+}
+
+// Inline commands (no leading '*') are a single line split on whitespace,
+// which is what a plain telnet session sends.
+RespParser::Status RespParser::parseInline(const std::string& buf, std::vector<std::string_view>& tokens) {
+    size_t newline = buf.find('\n', pos);
+    if (newline == std::string::npos) {
+        if (buf.size() - pos > MAX_INLINE_LEN) return fail("too big inline request");
+        return Status::NeedMore;
+    }
+
+    splitInline(buf, pos, newline, tokens);
+    pos = newline + 1;
+    frameStart = pos;
+    return Status::Command;
+}
+
+std::vector<std::string_view> parseRespCommand(const std::string& command) {
+    RespParser parser;
+    std::vector<std::string_view> tokens;
+    RespParser::Status status = parser.next(command, tokens);
+    if (status == RespParser::Status::NeedMore && !command.empty() && command[0] != '*') {
+        // An inline command may come without its trailing newline
+        splitInline(command, 0, command.size(), tokens);
+    } else if (status != RespParser::Status::Command) {
+        tokens.clear();
+    }
+    return tokens;
+}
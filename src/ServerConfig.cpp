@@ -0,0 +1,120 @@
+#include "../include/ServerConfig.h"
+#include "../include/Eviction.h"
+#include <iostream>
+#include <thread>
+#include <cctype>
+#include <stdexcept>
+
+ServerConfig& ServerConfig::getInstance() {
+    static ServerConfig instance;
+    return instance;
+}
+
+bool parseMemorySize(const std::string& str, size_t& bytes) {
+    size_t idx = 0;
+    unsigned long long value;
+    try {
+        value = std::stoull(str, &idx);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    std::string unit = str.substr(idx);
+    for (auto& c : unit) c = std::tolower(static_cast<unsigned char>(c));
+    unsigned long long multiplier = 1;
+    if (unit == "k" || unit == "kb") multiplier = 1024ULL;
+    else if (unit == "m" || unit == "mb") multiplier = 1024ULL * 1024;
+    else if (unit == "g" || unit == "gb") multiplier = 1024ULL * 1024 * 1024;
+    else if (!unit.empty() && unit != "b") return false;
+
+    bytes = value * multiplier;
+    return true;
+}
+
+bool ServerConfig::parseArgs(int argc, char* argv[]) {
+    int i = 1;
+    // A leading bare number is the port, as in earlier versions
+    if (i < argc && argv[i][0] != '-') port = std::stoi(argv[i++]);
+
+    for (; i < argc; i++) {
+        std::string opt = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for option " << opt << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (opt == "--port") {
+                port = std::stoi(value);
+            } else if (opt == "--io-threads") {
+                ioThreads = std::stoi(value);
+            } else if (opt == "--client-output-buffer-limit") {
+                if (!parseMemorySize(value, outputBufferLimit)) throw std::invalid_argument(value);
+            } else if (opt == "--dbfilename") {
+                dbFilename = value;
+            } else if (opt == "--save-interval") {
+                saveInterval = std::stoi(value);
+            } else if (opt == "--appendonly") {
+                if (value != "yes" && value != "no") throw std::invalid_argument(value);
+                appendOnly = value == "yes";
+            } else if (opt == "--appendfilename") {
+                appendFilename = value;
+            } else if (opt == "--appendfsync") {
+                if (value != "always" && value != "everysec" && value != "no") throw std::invalid_argument(value);
+                appendFsync = value;
+            } else if (opt == "--maxmemory") {
+                if (!parseMemorySize(value, maxmemory)) throw std::invalid_argument(value);
+            } else if (opt == "--maxmemory-policy") {
+                EvictionPolicy policy;
+                if (!parseEvictionPolicy(value, policy)) throw std::invalid_argument(value);
+                maxmemoryPolicy = value;
+            } else if (opt == "--maxmemory-samples") {
+                maxmemorySamples = std::stoul(value);
+                if (maxmemorySamples == 0) throw std::invalid_argument(value);
+            } else if (opt == "--lfu-log-factor") {
+                lfuLogFactor = std::stoi(value);
+            } else if (opt == "--lfu-decay-time") {
+                lfuDecayTime = std::stoi(value);
+            } else if (opt == "--slowlog-log-slower-than") {
+                slowlogLogSlowerThan = std::stoll(value);
+            } else if (opt == "--slowlog-max-len") {
+                slowlogMaxLen = std::stoul(value);
+            } else if (opt == "--latency-monitor-threshold") {
+                latencyMonitorThreshold = std::stoul(value);
+            } else if (opt == "--activedefrag") {
+                if (value != "yes" && value != "no") throw std::invalid_argument(value);
+                activeDefrag = value == "yes";
+            } else if (opt == "--active-defrag-threshold-lower") {
+                activeDefragThresholdLower = std::stoi(value);
+                if (activeDefragThresholdLower < 0) throw std::invalid_argument(value);
+            } else if (opt == "--active-defrag-ignore-bytes") {
+                if (!parseMemorySize(value, activeDefragIgnoreBytes)) throw std::invalid_argument(value);
+            } else if (opt == "--auto-aof-rewrite-percentage") {
+                autoAofRewritePercentage = std::stoi(value);
+            } else if (opt == "--auto-aof-rewrite-min-size") {
+                if (!parseMemorySize(value, autoAofRewriteMinSize)) throw std::invalid_argument(value);
+            } else if (opt == "--snapshot-compression") {
+                if (value != "yes" && value != "no") throw std::invalid_argument(value);
+                snapshotCompression = value == "yes";
+            } else if (opt == "--hash-max-listpack-entries") {
+                hashMaxListpackEntries = std::stoul(value);
+            } else if (opt == "--hash-max-listpack-value") {
+                if (!parseMemorySize(value, hashMaxListpackValue)) throw std::invalid_argument(value);
+            } else if (opt == "--list-max-listpack-size") {
+                if (!parseMemorySize(value, listMaxListpackSize)) throw std::invalid_argument(value);
+            } else {
+                std::cerr << "Unknown option " << opt << "\n";
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for option " << opt << ": " << value << "\n";
+            return false;
+        }
+    }
+
+    if (ioThreads <= 0) {
+        ioThreads = std::thread::hardware_concurrency();
+        if (ioThreads <= 0) ioThreads = 1;
+    }
+    return true;
+}
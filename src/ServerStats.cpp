@@ -0,0 +1,118 @@
+#include "../include/ServerStats.h"
+#include "../include/CommandTable.h"
+#include "../include/Keyspace.h"
+#include "../include/Memory.h"
+#include <algorithm>
+
+static const uint64_t LATENCY_SUB_BUCKETS = 1ull << LATENCY_SUB_BUCKET_BITS;
+
+// Values below LATENCY_SUB_BUCKETS get a bucket each; above, the bucket is
+// the power of two and the next LATENCY_SUB_BUCKET_BITS bits below its top bit
+static size_t latencyBucket(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) return ns;
+    int shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BUCKET_BITS;
+    return ((shift + 1) << LATENCY_SUB_BUCKET_BITS) + ((ns >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+// Largest value that falls in bucket `i`
+static uint64_t latencyBucketMax(size_t i) {
+    if (i < LATENCY_SUB_BUCKETS) return i;
+    int shift = static_cast<int>(i >> LATENCY_SUB_BUCKET_BITS) - 1;
+    uint64_t top = (i & (LATENCY_SUB_BUCKETS - 1)) + LATENCY_SUB_BUCKETS + 1;
+    return shift + LATENCY_SUB_BUCKET_BITS + 1 >= 64 ? UINT64_MAX : (top << shift) - 1;
+}
+
+void CommandStats::record(uint64_t ns, bool failed) {
+    calls.add();
+    if (failed) failedCalls.add();
+    totalNs.add(ns);
+    latency[latencyBucket(ns)].add();
+}
+
+uint64_t ServerStats::CommandTotals::percentile(double percentile) const {
+    if (calls == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(percentile / 100 * calls + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += latency[i];
+        if (seen >= rank) return latencyBucketMax(i);
+    }
+    return latencyBucketMax(LATENCY_BUCKETS - 1);
+}
+
+ServerStats& ServerStats::getInstance() {
+    static ServerStats instance;
+    return instance;
+}
+
+ServerStats::ServerStats() : startedAtMs(steadyNowMs()) {}
+
+ThreadStats* ServerStats::registerThread() {
+    std::lock_guard<std::mutex> lock(mtx);
+    threads.push_back(std::make_unique<ThreadStats>(commandCount()));
+    return threads.back().get();
+}
+
+ServerStats::Totals ServerStats::collect() const {
+    Totals totals;
+    totals.commands.resize(commandCount());
+    std::lock_guard<std::mutex> lock(mtx);
+    uint64_t closed = 0;
+    for (const auto& t : threads) {
+        for (size_t id = 0; id < totals.commands.size(); id++) {
+            const CommandStats& from = t->commands[id];
+            CommandTotals& to = totals.commands[id];
+            uint64_t calls = from.calls.get();
+            if (calls == 0) continue;
+            to.calls += calls;
+            to.failedCalls += from.failedCalls.get();
+            to.totalNs += from.totalNs.get();
+            for (size_t b = 0; b < LATENCY_BUCKETS; b++) to.latency[b] += from.latency[b].get();
+            totals.commandsProcessed += calls;
+        }
+        totals.keyspaceHits += t->keyspaceHits.get();
+        totals.keyspaceMisses += t->keyspaceMisses.get();
+        totals.connectionsReceived += t->connectionsReceived.get();
+        closed += t->connectionsClosed.get();
+        totals.netInputBytes += t->netInputBytes.get();
+        totals.netOutputBytes += t->netOutputBytes.get();
+    }
+    // Counted by different reads, so a close may be seen without its accept
+    totals.connectedClients = totals.connectionsReceived > closed ? totals.connectionsReceived - closed : 0;
+    return totals;
+}
+
+void ServerStats::sample() {
+    uint64_t commands = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& t : threads) {
+            for (size_t id = 0; id < commandCount(); id++) commands += t->commands[id].calls.get();
+        }
+    }
+    size_t memory = usedMemory();
+    std::lock_guard<std::mutex> lock(mtx);
+    samples[sampleCount++ % STATS_SAMPLES] = {steadyNowMs(), commands};
+    if (memory > peak) peak = memory;
+}
+
+double ServerStats::instantaneousOpsPerSec() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (sampleCount < 2) return 0;
+    // Oldest and newest samples in the ring
+    size_t n = std::min(sampleCount, STATS_SAMPLES);
+    const auto& newest = samples[(sampleCount - 1) % STATS_SAMPLES];
+    const auto& oldest = samples[(sampleCount - n) % STATS_SAMPLES];
+    int64_t ms = newest.first - oldest.first;
+    return ms > 0 ? (newest.second - oldest.second) * 1000.0 / ms : 0;
+}
+
+size_t ServerStats::peakMemory() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return std::max(peak, usedMemory());
+}
+
+int64_t ServerStats::uptimeMs() const {
+    return steadyNowMs() - startedAtMs;
+}
@@ -0,0 +1,136 @@
+#include "../include/Slab.h"
+#include "../include/Memory.h"
+#include <new>
+
+SlabAllocator::~SlabAllocator() {
+    // Only empty slabs are left: each class keeps its last one
+    for (Slab* slab : partial) {
+        while (slab) {
+            Slab* next = slab->next;
+            freePage(slab);
+            slab = next;
+        }
+    }
+}
+
+void SlabAllocator::link(Slab* slab) {
+    Slab*& head = partial[slab->cls];
+    slab->prev = nullptr;
+    slab->next = head;
+    if (head) head->prev = slab;
+    head = slab;
+    slab->listed = true;
+}
+
+void SlabAllocator::unlink(Slab* slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else partial[slab->cls] = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = slab->next = nullptr;
+    slab->listed = false;
+}
+
+SlabAllocator::Slab* SlabAllocator::newSlab(size_t cls) {
+    Slab* slab = new (allocPage()) Slab();
+    slab->owner = this;
+    slab->chunkSize = static_cast<uint32_t>((cls + 1) * SLAB_CLASS_STEP);
+    slab->capacity = static_cast<uint32_t>((SLAB_SIZE - firstChunkOffset()) / slab->chunkSize);
+    slab->cls = static_cast<uint8_t>(cls);
+    slabCount[cls]++;
+    freeChunks[cls] += slab->capacity;
+    totalSlabs.fetch_add(1, std::memory_order_relaxed);
+    link(slab);
+    return slab;
+}
+
+void SlabAllocator::freeSlab(Slab* slab) {
+    if (slab->listed) unlink(slab);
+    if (!slab->draining) freeChunks[slab->cls] -= slab->capacity;
+    slabCount[slab->cls]--;
+    totalSlabs.fetch_sub(1, std::memory_order_relaxed);
+    freePage(slab);
+}
+
+void* SlabAllocator::allocate(size_t bytes) {
+    size_t cls = slabChunkSize(bytes) / SLAB_CLASS_STEP - 1;
+    std::lock_guard<std::mutex> lock(mtx);
+    Slab* slab = partial[cls];
+    if (!slab) slab = newSlab(cls);
+
+    void* p;
+    if (slab->freeList) {
+        p = slab->freeList;
+        slab->freeList = *static_cast<void**>(p);
+    } else {
+        p = reinterpret_cast<char*>(slab) + firstChunkOffset() + size_t(slab->carved++) * slab->chunkSize;
+    }
+    slab->used++;
+    freeChunks[cls]--;
+    liveChunks++;
+    usedBytes.fetch_add(slab->chunkSize, std::memory_order_relaxed);
+    countMemory(slab->chunkSize);
+    if (slab->used == slab->capacity) unlink(slab);
+    return p;
+}
+
+bool SlabAllocator::free(Slab* slab, void* p) {
+    bool wasFull = slab->used == slab->capacity;
+    *static_cast<void**>(p) = slab->freeList;
+    slab->freeList = p;
+    slab->used--;
+    liveChunks--;
+    usedBytes.fetch_sub(slab->chunkSize, std::memory_order_relaxed);
+    countMemory(-static_cast<int64_t>(slab->chunkSize));
+    if (!slab->draining) freeChunks[slab->cls]++;
+
+    // Return empty slabs, but keep one per class so a single key being
+    // added and removed does not allocate a slab each time
+    if (slab->used == 0 && (slab->draining || slabCount[slab->cls] > 1))
+        freeSlab(slab);
+    else if (wasFull && !slab->draining)
+        link(slab);
+    return released && liveChunks == 0;
+}
+
+void SlabAllocator::deallocate(void* p) {
+    Slab* slab = slabOf(p);
+    SlabAllocator* owner = slab->owner;
+    bool dead;
+    {
+        std::lock_guard<std::mutex> lock(owner->mtx);
+        dead = owner->free(slab, p);
+    }
+    if (dead) delete owner;
+}
+
+void SlabAllocator::release() {
+    bool dead;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        released = true;
+        dead = liveChunks == 0;
+    }
+    if (dead) delete this;
+}
+
+bool SlabAllocator::shouldMove(void* p) {
+    Slab* slab = slabOf(p);
+    std::lock_guard<std::mutex> lock(mtx);
+    if (slab->draining) return true;
+    if (slab->used * 2 > slab->capacity) return false;
+    // Its chunks must fit in the free chunks of the class's other slabs
+    uint64_t spare = slab->capacity - slab->used;
+    if (freeChunks[slab->cls] - spare < slab->used) return false;
+    slab->draining = true;
+    if (slab->listed) unlink(slab);
+    freeChunks[slab->cls] -= spare;
+    return true;
+}
+
+SlabAllocator::Stats SlabAllocator::stats() const {
+    Stats stats;
+    stats.slabs = totalSlabs.load(std::memory_order_relaxed);
+    stats.allocatedBytes = stats.slabs * SLAB_SIZE;
+    stats.usedBytes = usedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,85 @@
+#include "../include/SlowLog.h"
+#include "../include/ServerConfig.h"
+#include "../include/Keyspace.h"
+#include <algorithm>
+#include <thread>
+
+SlowLog& SlowLog::getInstance() {
+    static SlowLog instance;
+    return instance;
+}
+
+SlowLog::SlowLog()
+    : capacity(ServerConfig::getInstance().slowlogMaxLen), slots(new Slot[capacity]) {}
+
+void SlowLog::record(const std::vector<std::string_view>& tokens, uint64_t durationUs, std::string_view client) {
+    if (capacity == 0) return;
+
+    // Build the entry before touching the ring, so the slot is only held
+    // for the swap
+    SlowLogEntry entry;
+    entry.time = unixNowMs() / 1000;
+    entry.durationUs = durationUs;
+    entry.client.assign(client.data(), client.size());
+    size_t kept = std::min(tokens.size(), SLOWLOG_MAX_ARGS);
+    entry.args.reserve(kept);
+    for (size_t i = 0; i < kept; i++) {
+        // The last kept slot says how many arguments were left out
+        if (i == kept - 1 && kept < tokens.size()) {
+            entry.args.push_back("... (" + std::to_string(tokens.size() - i) + " more arguments)");
+            break;
+        }
+        std::string_view arg = tokens[i];
+        if (arg.size() <= SLOWLOG_MAX_ARG_LEN) {
+            entry.args.emplace_back(arg);
+        } else {
+            entry.args.emplace_back(arg.substr(0, SLOWLOG_MAX_ARG_LEN));
+            entry.args.back() += "... (" + std::to_string(arg.size() - SLOWLOG_MAX_ARG_LEN) + " more bytes)";
+        }
+    }
+
+    entry.id = nextId.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[entry.id % capacity];
+    if (slot.busy.exchange(true, std::memory_order_acquire)) {
+        droppedEntries.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // A writer a full lap ahead may have got here first; keep the newer entry
+    if (!slot.used || slot.entry.id < entry.id) {
+        std::swap(slot.entry, entry);
+        slot.used = true;
+    }
+    slot.busy.store(false, std::memory_order_release);
+    // The replaced entry is freed here, outside the slot
+}
+
+template <typename F>
+void SlowLog::forEachEntry(F&& f) const {
+    uint64_t first = firstId.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < capacity; i++) {
+        Slot& slot = slots[i];
+        while (slot.busy.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+        if (slot.used && slot.entry.id >= first) f(slot.entry);
+        slot.busy.store(false, std::memory_order_release);
+    }
+}
+
+std::vector<SlowLogEntry> SlowLog::get(size_t count) const {
+    std::vector<SlowLogEntry> entries;
+    forEachEntry([&](const SlowLogEntry& entry) { entries.push_back(entry); });
+    std::sort(entries.begin(), entries.end(),
+              [](const SlowLogEntry& a, const SlowLogEntry& b) { return a.id > b.id; });
+    if (entries.size() > count) entries.resize(count);
+    return entries;
+}
+
+size_t SlowLog::length() const {
+    size_t n = 0;
+    forEachEntry([&](const SlowLogEntry&) { n++; });
+    return n;
+}
+
+void SlowLog::reset() {
+    // Entries are left in their slots and hidden by id; the next lap overwrites them
+    firstId.store(nextId.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
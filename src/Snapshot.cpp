@@ -0,0 +1,239 @@
+#include "../include/Snapshot.h"
+#include "../include/Crc32.h"
+#include "../include/Lzf.h"
+#include <cstring>
+
+static const char MAGIC[] = "MYRDB";
+static const size_t MAGIC_LEN = 5;
+static const size_t HEADER_LEN = MAGIC_LEN + 4 + 4 + 8 + 4;
+static const size_t SECTION_HEADER_LEN = 4 + 8 + 4;
+// Strings shorter than this are not worth compressing: there are few
+// matches to find in them, and every attempt costs a pass over the bytes
+static const size_t COMPRESS_MIN = 128;
+
+static void putU32(std::string& out, uint32_t v) {
+    char b[4];
+    for (int i = 0; i < 4; i++) b[i] = static_cast<char>(v >> (8 * i));
+    out.append(b, 4);
+}
+
+static void putU64(std::string& out, uint64_t v) {
+    char b[8];
+    for (int i = 0; i < 8; i++) b[i] = static_cast<char>(v >> (8 * i));
+    out.append(b, 8);
+}
+
+static uint64_t getLE(const char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    return v;
+}
+
+static void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+static bool getVarint(std::string_view data, size_t& offset, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (offset >= data.size()) return false;
+        uint8_t byte = static_cast<uint8_t>(data[offset++]);
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static void putString(std::string& out, std::string_view str, bool compress) {
+    if (compress && str.size() >= COMPRESS_MIN) {
+        // Compress into a scratch buffer first: the length prefix goes in
+        // front and depends on the compressed size.
+        thread_local std::string packed;
+        packed.clear();
+        if (lzfCompress(str, packed)) {
+            putVarint(out, (packed.size() << 1) | 1);
+            putVarint(out, str.size());
+            out.append(packed);
+            return;
+        }
+    }
+    putVarint(out, str.size() << 1);
+    out.append(str.data(), str.size());
+}
+
+// Read a string into `view`. Uncompressed strings point into `data`;
+// compressed ones are expanded into `scratch`.
+static bool getString(std::string_view data, size_t& offset, std::string_view& view, std::string& scratch) {
+    uint64_t header;
+    if (!getVarint(data, offset, header)) return false;
+    uint64_t len = header >> 1;
+    if (header & 1) {
+        uint64_t rawLen;
+        if (!getVarint(data, offset, rawLen)) return false;
+        // LZF expands at most ~90x; anything claiming more is corrupt
+        if (len > data.size() - offset || rawLen > len * 100) return false;
+        scratch.clear();
+        if (!lzfDecompress(data.substr(offset, len), rawLen, scratch)) return false;
+        view = scratch;
+    } else {
+        if (len > data.size() - offset) return false;
+        view = data.substr(offset, len);
+    }
+    offset += len;
+    return true;
+}
+
+void encodeSnapshotHeader(std::string& out, const SnapshotHeader& header) {
+    size_t start = out.size();
+    out.append(MAGIC, MAGIC_LEN);
+    putU32(out, header.version);
+    putU32(out, header.sections);
+    putU64(out, static_cast<uint64_t>(header.savedAtMs));
+    putU32(out, crc32(out.data() + start, out.size() - start));
+}
+
+void encodeSnapshotEntry(std::string& payload, const KeyEntry& entry, int64_t expireAtMs, bool compress) {
+    uint8_t type = 0;
+    const Listpack* packed = nullptr;
+    switch (entry.type()) {
+        case ObjectType::String:
+            type = SNAPSHOT_STRING;
+            break;
+        case ObjectType::List:
+            packed = entry.list().listpack();
+            type = packed ? SNAPSHOT_LIST_LISTPACK : SNAPSHOT_LIST;
+            break;
+        case ObjectType::Hash:
+            packed = entry.hash().listpack();
+            type = packed ? SNAPSHOT_HASH_LISTPACK : SNAPSHOT_HASH;
+            break;
+    }
+    payload.push_back(static_cast<char>(expireAtMs ? type | SNAPSHOT_EXPIRES : type));
+    if (expireAtMs) putU64(payload, static_cast<uint64_t>(expireAtMs));
+    putString(payload, entry.key(), false);
+
+    if (packed) {
+        putString(payload, packed->data(), compress);
+        return;
+    }
+    switch (entry.type()) {
+        case ObjectType::String:
+            putString(payload, entry.str(), compress);
+            break;
+        case ObjectType::List:
+            putVarint(payload, entry.list().size());
+            entry.list().forEach([&](std::string_view item) {
+                putString(payload, item, compress);
+            });
+            break;
+        case ObjectType::Hash:
+            putVarint(payload, entry.hash().size());
+            entry.hash().forEach([&](std::string_view field, std::string_view value) {
+                putString(payload, field, compress);
+                putString(payload, value, compress);
+            });
+            break;
+    }
+}
+
+void encodeSnapshotSectionHeader(std::string& out, uint32_t entries, std::string_view payload) {
+    putU32(out, entries);
+    putU64(out, payload.size());
+    putU32(out, crc32(payload.data(), payload.size()));
+}
+
+bool isSnapshot(std::string_view data) {
+    return data.size() >= MAGIC_LEN && memcmp(data.data(), MAGIC, MAGIC_LEN) == 0;
+}
+
+bool decodeSnapshotHeader(std::string_view data, size_t& offset, SnapshotHeader& header) {
+    if (data.size() - offset < HEADER_LEN || !isSnapshot(data.substr(offset))) return false;
+    const char* p = data.data() + offset;
+    if (crc32(p, HEADER_LEN - 4) != getLE(p + HEADER_LEN - 4, 4)) return false;
+    header.version = static_cast<uint32_t>(getLE(p + MAGIC_LEN, 4));
+    header.sections = static_cast<uint32_t>(getLE(p + MAGIC_LEN + 4, 4));
+    header.savedAtMs = static_cast<int64_t>(getLE(p + MAGIC_LEN + 8, 8));
+    if (header.version != SNAPSHOT_VERSION) return false;
+    offset += HEADER_LEN;
+    return true;
+}
+
+bool decodeSnapshotSection(std::string_view data, size_t& offset, SnapshotSection& section) {
+    if (data.size() - offset < SECTION_HEADER_LEN) return false;
+    const char* p = data.data() + offset;
+    section.entries = static_cast<uint32_t>(getLE(p, 4));
+    uint64_t len = getLE(p + 4, 8);
+    section.crc = static_cast<uint32_t>(getLE(p + 12, 4));
+    if (len > data.size() - offset - SECTION_HEADER_LEN) return false;
+    section.payload = data.substr(offset + SECTION_HEADER_LEN, len);
+    offset += SECTION_HEADER_LEN + len;
+    return true;
+}
+
+bool verifySnapshotSection(const SnapshotSection& section) {
+    return crc32(section.payload.data(), section.payload.size()) == section.crc;
+}
+
+bool decodeSnapshotEntry(std::string_view payload, size_t& offset, SnapshotEntry& entry) {
+    thread_local std::string scratch, keyScratch;
+    if (offset >= payload.size()) return false;
+    uint8_t type = static_cast<uint8_t>(payload[offset++]);
+
+    entry.expireAtMs = 0;
+    if (type & SNAPSHOT_EXPIRES) {
+        if (payload.size() - offset < 8) return false;
+        entry.expireAtMs = static_cast<int64_t>(getLE(payload.data() + offset, 8));
+        offset += 8;
+        type &= ~SNAPSHOT_EXPIRES;
+    }
+    if (!getString(payload, offset, entry.key, keyScratch)) return false;
+
+    std::string_view str;
+    uint64_t count;
+    switch (type) {
+        case SNAPSHOT_STRING:
+            if (!getString(payload, offset, str, scratch)) return false;
+            entry.value = std::string(str);
+            return true;
+        case SNAPSHOT_LIST_LISTPACK: {
+            auto list = std::make_unique<RedisList>();
+            if (!getString(payload, offset, str, scratch) || !list->loadListpack(str)) return false;
+            entry.value = std::move(list);
+            return true;
+        }
+        case SNAPSHOT_HASH_LISTPACK: {
+            auto hash = std::make_unique<RedisHash>();
+            if (!getString(payload, offset, str, scratch) || !hash->loadListpack(str)) return false;
+            entry.value = std::move(hash);
+            return true;
+        }
+        case SNAPSHOT_LIST: {
+            if (!getVarint(payload, offset, count)) return false;
+            auto list = std::make_unique<RedisList>();
+            for (uint64_t i = 0; i < count; i++) {
+                if (!getString(payload, offset, str, scratch)) return false;
+                list->pushBack(str);
+            }
+            entry.value = std::move(list);
+            return true;
+        }
+        case SNAPSHOT_HASH: {
+            if (!getVarint(payload, offset, count)) return false;
+            auto hash = std::make_unique<RedisHash>();
+            std::string field;
+            for (uint64_t i = 0; i < count; i++) {
+                if (!getString(payload, offset, str, scratch)) return false;
+                field.assign(str);
+                if (!getString(payload, offset, str, scratch)) return false;
+                hash->set(field, str);
+            }
+            entry.value = std::move(hash);
+            return true;
+        }
+    }
+    return false;
+}
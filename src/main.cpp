@@ -1,32 +1,103 @@
 #include "../include/RedisServer.h"
 #include "../include/RedisDatabase.h"
+#include "../include/ServerConfig.h"
+#include "../include/RedisCommandHandler.h"
+#include "../include/AppendOnlyFile.h"
+#include "../include/ServerStats.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <fstream>
 
 int main(int argc, char* argv[]) {
-    int port = 6379; // Default port number for Redis
-    // int port = 45812;
-    if (argc >= 2) port = std::stoi(argv[1]);
+    ServerConfig& config = ServerConfig::getInstance();
+    if (!config.parseArgs(argc, argv)) return 1;
+    int64_t startedAt = steadyNowMs();
+    ServerStats::getInstance(); // Uptime counts from here
     
-    if (!RedisDatabase::getInstance().load("dump.my_rdb"))
-        std::cout << "No dump found or load failed; starting with an empty database.\n";
+    if (config.appendOnly && std::ifstream(config.appendFilename)) {
+        // The append-only file is the most complete record: replay it
+        // instead of loading the snapshot
+        RedisCommandHandler handler;
+        if (!AppendOnlyFile::load(config.appendFilename, handler)) {
+            std::cerr << "Failed to load " << config.appendFilename << "; fix or remove it to start.\n";
+            return 1;
+        }
+    } else {
+        if (!RedisDatabase::getInstance().load(config.dbFilename)) {
+            // Refuse to start over a damaged snapshot: the next save would replace it
+            if (std::ifstream(config.dbFilename)) {
+                std::cerr << "Failed to load " << config.dbFilename << "; fix or remove it to start.\n";
+                return 1;
+            }
+            std::cout << "No dump found; starting with an empty database.\n";
+        }
+        // First start with the log enabled: seed it with what the snapshot held
+        if (config.appendOnly && !RedisDatabase::getInstance().writeAofImage(config.appendFilename)) return 1;
+    }
+
+    if (config.appendOnly) {
+        AppendOnlyFile::FsyncPolicy policy = AppendOnlyFile::FsyncPolicy::EverySec;
+        if (config.appendFsync == "always") policy = AppendOnlyFile::FsyncPolicy::Always;
+        else if (config.appendFsync == "no") policy = AppendOnlyFile::FsyncPolicy::No;
+        if (!AppendOnlyFile::getInstance().open(config.appendFilename, policy)) return 1;
+
+        // Compact the log in the background whenever it has grown enough
+        std::thread rewriteThread([](){
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                AppendOnlyFile::getInstance().rewriteIfGrown();
+            }
+        });
+        rewriteThread.detach();
+    }
+
 
+    std::cout << "Startup took " << steadyNowMs() - startedAt << " ms\n";
 
-    RedisServer server(port);
-    // Background persistance: dump the database every 300 seconds. (5 * 60 save database)
-    std::thread persistanceThread([](){
+    RedisServer server(config.port, config.ioThreads);
+    // Background persistance: snapshot the database every saveInterval seconds
+    // (300 by default) in a forked child, without blocking clients.
+    if (config.saveInterval > 0) {
+        std::thread persistanceThread([&config](){
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::seconds(config.saveInterval));
+                if (!RedisDatabase::getInstance().backgroundSave(config.dbFilename)) {
+                    std::cerr << "Background save not started\n";
+                }
+            }
+        });
+        persistanceThread.detach();
+    }
+
+    // Active expiry: reclaim keys whose TTL passed even if they are never read again
+    std::thread expireThread([](){
         while (true) {
-            std::this_thread::sleep_for(std::chrono::seconds(300));
-            if (!RedisDatabase::getInstance().dump("dump.my_rdb")) {
-                std::cerr << "Error dumping database\n";
-            } else {
-                std::cout << "Database dumped to dump.my_rdb successfully\n";
+            std::this_thread::sleep_for(std::chrono::milliseconds(RedisDatabase::ACTIVE_EXPIRE_INTERVAL_MS));
+            RedisDatabase::getInstance().activeExpireCycle(RedisDatabase::ACTIVE_EXPIRE_BUDGET_MS);
+        }
+    });
+    expireThread.detach();
+
+    // Active defrag: empty sparse slabs once deletions have left enough holes
+    if (config.activeDefrag) {
+        std::thread defragThread([](){
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(RedisDatabase::ACTIVE_DEFRAG_INTERVAL_MS));
+                RedisDatabase::getInstance().activeDefragCycle(RedisDatabase::ACTIVE_DEFRAG_BUDGET_MS);
             }
+        });
+        defragThread.detach();
+    }
 
+    // Samples for the instantaneous rates and peak memory in INFO
+    std::thread statsThread([](){
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ServerStats::STATS_SAMPLE_INTERVAL_MS));
+            ServerStats::getInstance().sample();
         }
     });
-    persistanceThread.detach();
+    statsThread.detach();
 
     server.run();
     
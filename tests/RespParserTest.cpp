@@ -0,0 +1,121 @@
+// RespParser checks (make test): frames split across reads, pipelined
+// batches, inline commands and the request limits.
+
+#include "TestHarness.h"
+#include "../include/RespParser.h"
+#include <string>
+#include <vector>
+
+static std::string resp(const std::vector<std::string>& args) {
+    std::string out = "*" + std::to_string(args.size()) + "\r\n";
+    for (const std::string& arg : args) out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    return out;
+}
+
+static bool tokensAre(const std::vector<std::string_view>& tokens, const std::vector<std::string>& expected) {
+    if (tokens.size() != expected.size()) return false;
+    for (size_t i = 0; i < tokens.size(); i++)
+        if (tokens[i] != expected[i]) return false;
+    return true;
+}
+
+// Status of the first command parsed out of `input` in one read
+static RespParser::Status parseOnce(const std::string& input) {
+    RespParser parser;
+    std::vector<std::string_view> tokens;
+    return parser.next(input, tokens);
+}
+
+// Feed the frame one byte at a time after a split at every offset: the
+// parser must wait until the last byte and then yield the whole command.
+TEST_CASE(frameSplitAtEveryByte) {
+    std::vector<std::string> command{"SET", "key", std::string("va\r\nlue", 7), ""};
+    std::string frame = resp(command);
+    for (size_t split = 0; split <= frame.size(); split++) {
+        RespParser parser;
+        std::vector<std::string_view> tokens;
+        std::string buf = frame.substr(0, split);
+        RespParser::Status status = parser.next(buf, tokens);
+        for (size_t i = split; i < frame.size(); i++) {
+            check(status == RespParser::Status::NeedMore, "incomplete frame asks for more");
+            buf += frame[i];
+            status = parser.next(buf, tokens);
+        }
+        check(status == RespParser::Status::Command, "frame completes on its last byte");
+        check(tokensAre(tokens, command), "split frame yields the original arguments");
+        check(parser.consumed() == frame.size(), "whole frame consumed");
+    }
+}
+
+// Several commands read at once come out one per call, and a trailing
+// partial frame survives compact() and completes on the next read
+TEST_CASE(pipelinedBatch) {
+    std::vector<std::vector<std::string>> commands{{"SET", "a", "1"}, {"GET", "a"}, {"LPUSH", "l", "x", "y", "z"}, {"PING"}};
+    std::string buf;
+    for (const auto& command : commands) buf += resp(command);
+    std::string partial = resp({"DEL", "a"});
+    buf += partial.substr(0, 5);
+
+    RespParser parser;
+    std::vector<std::string_view> tokens;
+    for (const auto& command : commands) {
+        check(parser.next(buf, tokens) == RespParser::Status::Command, "pipelined command parsed");
+        check(tokensAre(tokens, command), "pipelined command has its arguments");
+    }
+    check(parser.next(buf, tokens) == RespParser::Status::NeedMore, "trailing partial frame waits");
+
+    buf.erase(0, parser.consumed());
+    parser.compact();
+    check(buf == partial.substr(0, 5), "compact keeps only the partial frame");
+    buf += partial.substr(5);
+    check(parser.next(buf, tokens) == RespParser::Status::Command, "partial frame completes after compact");
+    check(tokensAre(tokens, {"DEL", "a"}), "completed frame has its arguments");
+}
+
+TEST_CASE(inlineCommands) {
+    RespParser parser;
+    std::vector<std::string_view> tokens;
+    std::string buf = "SET  key value\r\n\r\nPING\nGET key";
+    check(parser.next(buf, tokens) == RespParser::Status::Command, "inline command parsed");
+    check(tokensAre(tokens, {"SET", "key", "value"}), "inline command split on whitespace");
+    check(parser.next(buf, tokens) == RespParser::Status::Command, "blank line skipped");
+    check(tokensAre(tokens, {"PING"}), "inline command ended by a bare newline");
+    check(parser.next(buf, tokens) == RespParser::Status::NeedMore, "inline command waits for its newline");
+    buf += "\r\n" + resp({"ECHO", "hi"});
+    check(parser.next(buf, tokens) == RespParser::Status::Command && tokensAre(tokens, {"GET", "key"}),
+          "inline command completes");
+    check(parser.next(buf, tokens) == RespParser::Status::Command && tokensAre(tokens, {"ECHO", "hi"}),
+          "RESP frame after an inline command");
+
+    check(parseOnce(std::string(RespParser::MAX_INLINE_LEN + 1, 'x')) == RespParser::Status::Error,
+          "inline request over MAX_INLINE_LEN rejected");
+}
+
+TEST_CASE(oversizeHeaders) {
+    std::string maxArgs = std::to_string(RespParser::MAX_ARGS);
+    std::string maxBulk = std::to_string(RespParser::MAX_BULK_LEN);
+    check(parseOnce("*" + maxArgs + "\r\n") == RespParser::Status::NeedMore, "MAX_ARGS arguments accepted");
+    check(parseOnce("*" + std::to_string(RespParser::MAX_ARGS + 1) + "\r\n") == RespParser::Status::Error,
+          "more than MAX_ARGS arguments rejected");
+    check(parseOnce("*1\r\n$" + maxBulk + "\r\n") == RespParser::Status::NeedMore, "MAX_BULK_LEN bulk accepted");
+    check(parseOnce("*1\r\n$" + std::to_string(RespParser::MAX_BULK_LEN + 1) + "\r\n") == RespParser::Status::Error,
+          "bulk over MAX_BULK_LEN rejected");
+    check(parseOnce("*1\r\n$" + std::string(RespParser::MAX_INLINE_LEN + 1, '1')) == RespParser::Status::Error,
+          "unterminated bulk header over MAX_INLINE_LEN rejected");
+}
+
+TEST_CASE(badLengths) {
+    check(parseOnce("*1\r\n$-1\r\n") == RespParser::Status::Error, "negative bulk length rejected");
+    check(parseOnce("*1\r\n$abc\r\nabc\r\n") == RespParser::Status::Error, "non-numeric bulk length rejected");
+    check(parseOnce("*1\r\n$\r\n") == RespParser::Status::Error, "empty bulk length rejected");
+    check(parseOnce("*x\r\n") == RespParser::Status::Error, "non-numeric argument count rejected");
+    check(parseOnce("*1\r\n+OK\r\n") == RespParser::Status::Error, "argument that is not a bulk string rejected");
+    check(parseOnce("*1\r\n$3\r\nabcd\r\n") == RespParser::Status::Error, "bulk longer than its length rejected");
+
+    // A null or empty array is no command at all and is skipped
+    RespParser parser;
+    std::vector<std::string_view> tokens;
+    std::string buf = "*-1\r\n*0\r\n" + resp({"PING"});
+    check(parser.next(buf, tokens) == RespParser::Status::Command && tokensAre(tokens, {"PING"}),
+          "null and empty arrays skipped");
+}
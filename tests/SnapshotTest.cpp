@@ -0,0 +1,170 @@
+// Snapshot and LZF checks (make test): a dump() / load() round trip of
+// every type and encoding, checksum failures, and malformed LZF input.
+
+#include "TestHarness.h"
+#include "../include/RedisDatabase.h"
+#include "../include/Snapshot.h"
+#include "../include/Lzf.h"
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <unistd.h>
+
+static const std::string snapshotFile = "snapshot-test-" + std::to_string(getpid()) + ".my_rdb";
+
+static std::string readFile(const std::string& filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& filename, const std::string& data) {
+    std::ofstream(filename, std::ios::binary | std::ios::trunc) << data;
+}
+
+// Type tag of every key in a snapshot, without the SNAPSHOT_EXPIRES bit;
+// empty if the file does not decode
+static std::map<std::string, uint8_t> snapshotTypes(const std::string& data) {
+    std::map<std::string, uint8_t> types;
+    size_t offset = 0;
+    SnapshotHeader header;
+    if (!decodeSnapshotHeader(data, offset, header)) return {};
+    for (uint32_t i = 0; i < header.sections; i++) {
+        SnapshotSection section;
+        if (!decodeSnapshotSection(data, offset, section) || !verifySnapshotSection(section)) return {};
+        size_t pos = 0;
+        for (uint32_t n = 0; n < section.entries; n++) {
+            SnapshotEntry entry;
+            size_t start = pos;
+            if (!decodeSnapshotEntry(section.payload, pos, entry)) return {};
+            types[std::string(entry.key)] = static_cast<uint8_t>(section.payload[start]) & ~SNAPSHOT_EXPIRES;
+        }
+    }
+    return types;
+}
+
+static void pushAll(RedisDatabase& db, const std::string& key, const std::vector<std::string>& items) {
+    std::vector<std::string_view> views(items.begin(), items.end());
+    db.rpush(key, views.data(), views.size());
+}
+
+static std::vector<std::string> listOf(RedisDatabase& db, const std::string& key) {
+    std::vector<std::string> items;
+    ssize_t len = db.llen(key);
+    for (ssize_t i = 0; i < len; i++) {
+        std::string item;
+        db.lindex(key, static_cast<int>(i), item);
+        items.push_back(item);
+    }
+    return items;
+}
+
+static std::map<std::string, std::string> hashOf(RedisDatabase& db, const std::string& key) {
+    std::map<std::string, std::string> fields;
+    for (auto& field : db.hgetall(key)) fields.insert(field);
+    return fields;
+}
+
+// Every type in both of its encodings, short and long (compressed) strings
+// and TTLs come back from a snapshot as they were saved
+TEST_CASE(snapshotRoundTrip) {
+    RedisDatabase& db = RedisDatabase::getInstance();
+    db.flushAll();
+
+    std::string shortValue = "short value";
+    std::string longValue;
+    while (longValue.size() < 1000) longValue += "a compressible value " + std::to_string(longValue.size() % 7);
+    db.set("string:short", shortValue);
+    db.set("string:long", longValue);
+
+    std::vector<std::string> smallList{"x", "y", "z"};
+    std::vector<std::string> bigList;
+    for (int i = 0; i < 2000; i++) bigList.push_back("list item number " + std::to_string(i));
+    pushAll(db, "list:small", smallList);
+    pushAll(db, "list:big", bigList);
+
+    std::map<std::string, std::string> smallHash{{"f1", "v1"}, {"f2", "v2"}};
+    std::map<std::string, std::string> bigHash;
+    for (int i = 0; i < 300; i++) bigHash["field" + std::to_string(i)] = "value" + std::to_string(i);
+    for (const auto& field : smallHash) db.hset("hash:small", field.first, field.second);
+    for (const auto& field : bigHash) db.hset("hash:big", field.first, field.second);
+
+    db.set("ttl:live", "1");
+    db.expire("ttl:live", 1000);
+
+    check(db.dump(snapshotFile), "dump succeeds");
+    std::string data = readFile(snapshotFile);
+    std::map<std::string, uint8_t> types = snapshotTypes(data);
+    check(types.size() == 7, "every key written");
+    check(types["list:small"] == SNAPSHOT_LIST_LISTPACK && types["list:big"] == SNAPSHOT_LIST,
+          "lists saved in both encodings");
+    check(types["hash:small"] == SNAPSHOT_HASH_LISTPACK && types["hash:big"] == SNAPSHOT_HASH,
+          "hashes saved in both encodings");
+    check(data.find(shortValue) != std::string::npos, "string under COMPRESS_MIN stored as is");
+    check(data.find(longValue) == std::string::npos, "string over COMPRESS_MIN stored compressed");
+
+    db.flushAll();
+    check(db.load(snapshotFile), "load succeeds");
+    std::string value;
+    check(db.get("string:short", value) && value == shortValue, "short string round trip");
+    check(db.get("string:long", value) && value == longValue, "compressed string round trip");
+    check(listOf(db, "list:small") == smallList, "listpack list round trip");
+    check(listOf(db, "list:big") == bigList, "quicklist round trip");
+    check(hashOf(db, "hash:small") == smallHash, "listpack hash round trip");
+    check(hashOf(db, "hash:big") == bigHash, "dict hash round trip");
+    check(db.exists("ttl:live") && db.keyspaceStats().volatileKeys == 1, "TTL round trip");
+
+    std::remove(snapshotFile.c_str());
+}
+
+// A byte flipped inside a section fails its CRC: load() reports the file
+// as corrupt rather than loading the damaged value
+TEST_CASE(snapshotCorruptSection) {
+    RedisDatabase& db = RedisDatabase::getInstance();
+    db.flushAll();
+    std::string original = "value that will be damaged";
+    db.set("victim", original);
+    check(db.dump(snapshotFile), "dump succeeds");
+
+    std::string data = readFile(snapshotFile);
+    size_t at = data.find(original);
+    check(at != std::string::npos, "value found in the snapshot");
+    if (at != std::string::npos) {
+        data[at] ^= 0x01;
+        writeFile(snapshotFile, data);
+        check(!db.load(snapshotFile), "load fails on a bad section checksum");
+        std::string value;
+        check(!db.get("victim", value) || value == original, "damaged value not loaded");
+    }
+    std::remove(snapshotFile.c_str());
+}
+
+TEST_CASE(lzfMalformedInput) {
+    // "ab" as literals, then a back reference of 4 bytes, 2 back: "ababab"
+    const std::string valid("\x01" "ab" "\x40\x01", 5);
+    std::string out;
+    check(lzfDecompress(valid, 6, out) && out == "ababab", "hand-built stream decodes");
+
+    out.clear();
+    check(!lzfDecompress(valid.substr(0, 4), 6, out), "back reference missing its offset byte rejected");
+    out.clear();
+    check(!lzfDecompress(valid.substr(0, 2), 6, out), "literal run cut short rejected");
+    out.clear();
+    check(!lzfDecompress(std::string("\x01" "ab" "\x40\x04", 5), 6, out), "offset before the start rejected");
+    out.clear();
+    check(!lzfDecompress(valid, 5, out), "back reference past the raw length rejected");
+    out.clear();
+    check(!lzfDecompress(valid, 7, out), "stream shorter than the raw length rejected");
+
+    // What lzfCompress writes decodes back, and a truncated copy does not
+    std::string raw;
+    for (int i = 0; i < 200; i++) raw += "lzf round trip " + std::to_string(i % 10);
+    std::string packed;
+    check(lzfCompress(raw, packed), "repetitive input compresses");
+    out.clear();
+    check(lzfDecompress(packed, raw.size(), out) && out == raw, "compressed input round trip");
+    out.clear();
+    check(!lzfDecompress(packed.substr(0, packed.size() - 1), raw.size(), out), "truncated stream rejected");
+}
@@ -0,0 +1,20 @@
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+// Helpers shared by the test files (make test). Each file registers its
+// cases with TEST_CASE; TestMain.cpp runs them all and exits non-zero if
+// any check failed.
+
+// Report and count a failure unless `condition` holds
+void check(bool condition, const char* what);
+
+struct TestCase {
+    TestCase(const char* name, void (*run)());
+};
+
+#define TEST_CASE(name)                                  \
+    static void name();                                  \
+    static TestCase name##Registration(#name, name);     \
+    static void name()
+
+#endif
@@ -0,0 +1,37 @@
+// Runs every case registered with TEST_CASE (make test).
+
+#include "TestHarness.h"
+#include <iostream>
+#include <vector>
+#include <utility>
+
+static std::vector<std::pair<const char*, void (*)()>>& testCases() {
+    static std::vector<std::pair<const char*, void (*)()>> cases;
+    return cases;
+}
+
+static const char* currentCase = "";
+static int failures = 0;
+
+TestCase::TestCase(const char* name, void (*run)()) {
+    testCases().emplace_back(name, run);
+}
+
+void check(bool condition, const char* what) {
+    if (condition) return;
+    std::cerr << "FAILED: " << currentCase << ": " << what << "\n";
+    failures++;
+}
+
+int main() {
+    for (const auto& test : testCases()) {
+        currentCase = test.first;
+        test.second();
+    }
+    if (failures) {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "All " << testCases().size() << " test cases passed\n";
+    return 0;
+}